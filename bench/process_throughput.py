@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Parser.Process throughput: buffer protocol vs. element-wise copy
+#
+#    Usage: process_throughput.py [stream.ts] [megabytes]
+#
+#    Without a capture, a stream of null packets (PID 0x1FFF) is used, which
+#    mostly measures the wrapper overhead.
+
+from __future__ import print_function
+
+import sys
+import time
+
+import libtssipython
+
+
+def null_packets(size):
+    packet = bytearray(188)
+    packet[0:4] = b"\x47\x1f\xff\x10"
+    return packet * (size // 188)
+
+
+def load(path, size):
+    buffer = bytearray(size)
+    with open(path, "rb") as file:
+        read = file.readinto(buffer)
+    return buffer[:read - read % 188]
+
+
+def measure(label, buffer, wrap, repeat):
+    best = None
+    for _ in range(repeat):
+        parser = libtssipython.Parser()
+        data = wrap(buffer)
+        start = time.time()
+        parser.Process(data)
+        elapsed = time.time() - start
+        best = elapsed if best is None else min(best, elapsed)
+    megabytes = len(buffer) / (1024.0 * 1024.0)
+    print("%-28s %10.1f MB/s" % (label, megabytes / best))
+    return megabytes / best
+
+
+def main():
+    size = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+    size *= 1024 * 1024
+    buffer = load(sys.argv[1], size) if len(sys.argv) > 1 else null_packets(size)
+    print("%d bytes, %d packets" % (len(buffer), len(buffer) // 188))
+
+    fast = measure("bytearray (buffer protocol)", buffer, lambda b: b, 5)
+    measure("bytes (buffer protocol)", buffer, bytes, 5)
+    measure("memoryview (buffer protocol)", buffer, memoryview, 5)
+    slow = measure("iterator (element-wise copy)", buffer, iter, 1)
+    print("speedup %.1fx" % (fast / slow))
+
+
+if __name__ == "__main__":
+    main()
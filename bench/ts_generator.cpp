@@ -0,0 +1,499 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "ts_generator.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace tssibench {
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+// 2016-10-28 20:00:00 UTC
+const unsigned BASE_MJD = 57689;
+const unsigned BASE_SECONDS = 20 * 3600;
+
+const unsigned EVENT_DURATION = 30 * 60;
+
+unsigned Crc32(const unsigned char* data, std::size_t length) {
+	static unsigned table[256];
+	static bool initialized = false;
+	if (!initialized) {
+		for (unsigned i = 0; i < 256; ++i) {
+			unsigned crc = i << 24;
+			for (int bit = 0; bit < 8; ++bit)
+				crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+			table[i] = crc;
+		}
+		initialized = true;
+	}
+
+	unsigned crc = 0xFFFFFFFF;
+	for (std::size_t i = 0; i < length; ++i)
+		crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xFF];
+	return crc;
+}
+
+void PutWord(Bytes& out, unsigned value) {
+	out.push_back(static_cast<unsigned char>(value >> 8));
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+unsigned char Bcd(unsigned value) {
+	return static_cast<unsigned char>(((value / 10) << 4) | (value % 10));
+}
+
+// MJD date and BCD time, 40 bits
+void PutUtc(Bytes& out, unsigned long long seconds) {
+	const unsigned days = static_cast<unsigned>(seconds / 86400);
+	const unsigned time = static_cast<unsigned>(seconds % 86400);
+	PutWord(out, BASE_MJD + days);
+	out.push_back(Bcd(time / 3600));
+	out.push_back(Bcd(time / 60 % 60));
+	out.push_back(Bcd(time % 60));
+}
+
+void PutString(Bytes& out, const std::string& value) {
+	out.push_back(static_cast<unsigned char>(value.size()));
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+// section with long header and CRC; PSI tables set private_indicator 0,
+// DVB SI tables 1
+Bytes LongSection(unsigned table_id, bool dvb, unsigned extension, unsigned version,
+		unsigned section_number, unsigned last_section_number, const Bytes& body) {
+	const unsigned length = 5 + static_cast<unsigned>(body.size()) + 4;
+	Bytes section;
+	section.push_back(static_cast<unsigned char>(table_id));
+	section.push_back(static_cast<unsigned char>((dvb ? 0xF0 : 0xB0) | (length >> 8)));
+	section.push_back(static_cast<unsigned char>(length));
+	PutWord(section, extension);
+	section.push_back(static_cast<unsigned char>(0xC1 | (version & 0x1F) << 1));
+	section.push_back(static_cast<unsigned char>(section_number));
+	section.push_back(static_cast<unsigned char>(last_section_number));
+	section.insert(section.end(), body.begin(), body.end());
+
+	const unsigned crc = Crc32(&section[0], section.size());
+	PutWord(section, crc >> 16);
+	PutWord(section, crc);
+	return section;
+}
+
+// EBU teletext travels LSB first in DVB data units
+unsigned char Reverse(unsigned char value) {
+	value = static_cast<unsigned char>((value & 0xF0) >> 4 | (value & 0x0F) << 4);
+	value = static_cast<unsigned char>((value & 0xCC) >> 2 | (value & 0x33) << 2);
+	return static_cast<unsigned char>((value & 0xAA) >> 1 | (value & 0x55) << 1);
+}
+
+unsigned char Hamming(unsigned nibble) {
+	static const unsigned char table[16] = {
+		0x15, 0x02, 0x49, 0x5E, 0x64, 0x73, 0x38, 0x2F, 0xD0, 0xC7, 0x8C, 0x9B, 0xA1, 0xB6, 0xFD, 0xEA
+	};
+	return Reverse(table[nibble & 0x0F]);
+}
+
+unsigned char OddParity(char character) {
+	unsigned char value = static_cast<unsigned char>(character & 0x7F);
+	unsigned ones = 0;
+	for (unsigned char bits = value; bits; bits &= bits - 1)
+		++ones;
+	if (!(ones & 1))
+		value |= 0x80;
+	return Reverse(value);
+}
+
+}
+
+GeneratorConfig::GeneratorConfig()
+	: services(8), events_per_service(16), bitrate(20000000), teletext_pid(0x404),
+	  pcr_interval_ms(40), pcr_jump_ms(0), pcr_jump_at_ms(0), psi_interval_ms(100), si_interval_ms(500), tdt_interval_ms(1000),
+	  teletext_interval_ms(20), transport_stream_id(1073), original_network_id(1), pack_sections(false),
+	  schedule_present(false), version(0) {
+}
+
+StreamGenerator::StreamGenerator(const GeneratorConfig& config)
+	: config_(config), packets_(0), continuity_(8192, 0), teletext_page_(0), filler_(0) {
+	if (config_.services == 0)
+		config_.services = 1;
+	if (config_.events_per_service < 2)
+		config_.events_per_service = 2;
+
+	psi_ = MakeSchedule(config_.psi_interval_ms, 0);
+	si_ = MakeSchedule(config_.si_interval_ms, 1);
+	tdt_ = MakeSchedule(config_.tdt_interval_ms, 2);
+	pcr_ = MakeSchedule(config_.pcr_interval_ms, 3);
+	teletext_ = MakeSchedule(config_.teletext_pid ? config_.teletext_interval_ms : 0, 4);
+
+	BuildTables();
+}
+
+void StreamGenerator::Generate(Bytes& stream, std::size_t packets) {
+	// bursts of sections may overshoot, the remainder starts the next call
+	const std::size_t needed = packets * 188;
+	while (pending_.size() < needed)
+		Step();
+
+	stream.insert(stream.end(), pending_.begin(), pending_.begin() + needed);
+	pending_.erase(pending_.begin(), pending_.begin() + needed);
+}
+
+void StreamGenerator::Step() {
+	if (Due(psi_)) {
+		EmitSection(0x00, pat_);
+		for (unsigned i = 0; i < pmts_.size(); ++i)
+			EmitSection(PmtPid(i), pmts_[i]);
+	}
+	else if (Due(si_)) {
+		EmitSection(0x11, sdt_);
+		if (config_.pack_sections) {
+			EmitPacked(0x12, eit_);
+		}
+		else {
+			for (unsigned i = 0; i < eit_.size(); ++i)
+				EmitSection(0x12, eit_[i]);
+		}
+	}
+	else if (Due(tdt_)) {
+		EmitTdt();
+	}
+	else if (Due(pcr_)) {
+		for (unsigned i = 0; i < config_.services; ++i)
+			EmitPcr(VideoPid(i));
+	}
+	else if (Due(teletext_)) {
+		EmitTeletext();
+	}
+	else {
+		EmitFiller();
+	}
+}
+
+void StreamGenerator::BuildTables() {
+	Bytes pat;
+	PutWord(pat, 0x0000);
+	PutWord(pat, 0xE000 | 0x10);
+	for (unsigned i = 0; i < config_.services; ++i) {
+		PutWord(pat, ProgramNumber(i));
+		PutWord(pat, 0xE000 | PmtPid(i));
+	}
+	pat_ = LongSection(0x00, false, config_.transport_stream_id, config_.version, 0, 0, pat);
+
+	for (unsigned i = 0; i < config_.services; ++i)
+		pmts_.push_back(BuildPmt(i));
+
+	sdt_ = BuildSdt();
+
+	for (unsigned i = 0; i < config_.services; ++i)
+		BuildEit(i);
+}
+
+StreamGenerator::Bytes StreamGenerator::BuildPmt(unsigned service) const {
+	Bytes pmt;
+	PutWord(pmt, 0xE000 | VideoPid(service));
+	PutWord(pmt, 0xF000);
+
+	pmt.push_back(0x02);
+	PutWord(pmt, 0xE000 | VideoPid(service));
+	PutWord(pmt, 0xF000);
+
+	pmt.push_back(0x03);
+	PutWord(pmt, 0xE000 | AudioPid(service));
+	PutWord(pmt, 0xF000);
+
+	if (service == 0 && config_.teletext_pid) {
+		// teletext descriptor: initial page 100
+		pmt.push_back(0x06);
+		PutWord(pmt, 0xE000 | config_.teletext_pid);
+		PutWord(pmt, 0xF000 | 7);
+		pmt.push_back(0x56);
+		pmt.push_back(5);
+		pmt.push_back('d');
+		pmt.push_back('e');
+		pmt.push_back('u');
+		pmt.push_back(0x01 << 3 | 0x01);
+		pmt.push_back(0x00);
+	}
+	return LongSection(0x02, false, ProgramNumber(service), config_.version, 0, 0, pmt);
+}
+
+StreamGenerator::Bytes StreamGenerator::BuildSdt() const {
+	Bytes sdt;
+	PutWord(sdt, config_.original_network_id);
+	sdt.push_back(0xFF);
+
+	for (unsigned i = 0; i < config_.services; ++i) {
+		char name[32];
+		std::sprintf(name, "Service %u", i + 1);
+
+		Bytes descriptor;
+		descriptor.push_back(0x48);
+		descriptor.push_back(0);
+		descriptor.push_back(0x01);
+		PutString(descriptor, "tssibench");
+		PutString(descriptor, name);
+		descriptor[1] = static_cast<unsigned char>(descriptor.size() - 2);
+
+		PutWord(sdt, ProgramNumber(i));
+		sdt.push_back(0xFF);
+		PutWord(sdt, 0x8000 | static_cast<unsigned>(descriptor.size()));
+		sdt.insert(sdt.end(), descriptor.begin(), descriptor.end());
+	}
+	return LongSection(0x42, true, config_.transport_stream_id, config_.version, 0, 0, sdt);
+}
+
+// present/following in table 0x4E, the rest of the schedule in 0x50
+void StreamGenerator::BuildEit(unsigned service) {
+	std::vector<Bytes> events;
+	for (unsigned i = 0; i < config_.events_per_service; ++i) {
+		char name[48], text[96];
+		std::sprintf(name, "Event %u of service %u", i + 1, service + 1);
+		std::sprintf(text, "Synthetic event %u, generated for throughput measurements", i + 1);
+
+		Bytes descriptor;
+		descriptor.push_back(0x4D);
+		descriptor.push_back(0);
+		descriptor.push_back('d');
+		descriptor.push_back('e');
+		descriptor.push_back('u');
+		PutString(descriptor, name);
+		PutString(descriptor, text);
+		descriptor[1] = static_cast<unsigned char>(descriptor.size() - 2);
+
+		Bytes event;
+		PutWord(event, i + 1);
+		PutUtc(event, BASE_SECONDS + static_cast<unsigned long long>(i) * EVENT_DURATION);
+		event.push_back(0x00);
+		event.push_back(0x30);
+		event.push_back(0x00);
+		const unsigned running_status = i == 0 ? 4 : 1;
+		PutWord(event, running_status << 13 | static_cast<unsigned>(descriptor.size()));
+		event.insert(event.end(), descriptor.begin(), descriptor.end());
+		events.push_back(event);
+	}
+
+	Bytes header;
+	PutWord(header, config_.transport_stream_id);
+	PutWord(header, config_.original_network_id);
+
+	for (unsigned i = 0; i < 2; ++i) {
+		Bytes body(header);
+		body.push_back(1);
+		body.push_back(0x4E);
+		body.insert(body.end(), events[i].begin(), events[i].end());
+		eit_.push_back(LongSection(0x4E, true, ProgramNumber(service), config_.version, i, 1, body));
+	}
+
+	std::vector<Bytes> bodies;
+	for (unsigned i = config_.schedule_present ? 0 : 2; i < events.size(); ++i) {
+		Bytes event(events[i]);
+		if (i < 2)
+			event[10] &= 0x1F;
+		if (bodies.empty() || bodies.back().size() + event.size() > 4000)
+			bodies.push_back(Bytes());
+		bodies.back().insert(bodies.back().end(), event.begin(), event.end());
+	}
+	for (unsigned i = 0; i < bodies.size(); ++i) {
+		const unsigned last = static_cast<unsigned>(bodies.size()) - 1;
+		Bytes body(header);
+		body.push_back(static_cast<unsigned char>(last));
+		body.push_back(0x50);
+		body.insert(body.end(), bodies[i].begin(), bodies[i].end());
+		eit_.push_back(LongSection(0x50, true, ProgramNumber(service), config_.version, i, last, body));
+	}
+}
+
+StreamGenerator::Schedule StreamGenerator::MakeSchedule(unsigned interval_ms, unsigned phase) const {
+	Schedule schedule;
+	schedule.interval = static_cast<unsigned long long>(config_.bitrate) * interval_ms / (188 * 8 * 1000);
+	if (interval_ms && schedule.interval == 0)
+		schedule.interval = 1;
+	schedule.next = interval_ms ? phase : ~0ULL;
+	return schedule;
+}
+
+bool StreamGenerator::Due(Schedule& schedule) {
+	if (packets_ < schedule.next)
+		return false;
+	schedule.next += schedule.interval;
+	return true;
+}
+
+unsigned char* StreamGenerator::NewPacket(unsigned pid, bool unit_start) {
+	pending_.resize(pending_.size() + 188, 0xFF);
+	unsigned char* packet = &pending_[pending_.size() - 188];
+	packet[0] = 0x47;
+	packet[1] = static_cast<unsigned char>((unit_start ? 0x40 : 0x00) | (pid >> 8 & 0x1F));
+	packet[2] = static_cast<unsigned char>(pid);
+	packet[3] = static_cast<unsigned char>(0x10 | continuity_[pid]);
+	continuity_[pid] = (continuity_[pid] + 1) & 0x0F;
+	++packets_;
+	return packet;
+}
+
+// every section starts a packet, the rest of the last one is stuffed
+void StreamGenerator::EmitSection(unsigned pid, const Bytes& section) {
+	std::size_t offset = 0;
+	bool first = true;
+	while (offset < section.size()) {
+		unsigned char* packet = NewPacket(pid, first);
+		unsigned char* payload = packet + 4;
+		std::size_t room = 184;
+		if (first) {
+			*payload++ = 0;
+			--room;
+			first = false;
+		}
+		const std::size_t chunk = section.size() - offset < room ? section.size() - offset : room;
+		std::memcpy(payload, &section[offset], chunk);
+		offset += chunk;
+	}
+}
+
+// sections back to back; a packet in which a section starts points to it,
+// the rest of the last one is stuffed
+void StreamGenerator::EmitPacked(unsigned pid, const std::vector<Bytes>& sections) {
+	Bytes payload;
+	std::vector<std::size_t> starts;
+	for (std::size_t i = 0; i < sections.size(); ++i) {
+		starts.push_back(payload.size());
+		payload.insert(payload.end(), sections[i].begin(), sections[i].end());
+	}
+
+	std::size_t offset = 0;
+	std::size_t next = 0;
+	while (offset < payload.size()) {
+		while (next < starts.size() && starts[next] < offset)
+			++next;
+		const bool unit_start = next < starts.size() && starts[next] < offset + 183;
+		unsigned char* packet = NewPacket(pid, unit_start);
+		unsigned char* data = packet + 4;
+		std::size_t room = 184;
+		if (unit_start) {
+			*data++ = static_cast<unsigned char>(starts[next] - offset);
+			--room;
+		}
+		const std::size_t chunk = payload.size() - offset < room ? payload.size() - offset : room;
+		std::memcpy(data, &payload[offset], chunk);
+		offset += chunk;
+	}
+}
+
+void StreamGenerator::EmitTdt() {
+	Bytes section;
+	section.push_back(0x70);
+	section.push_back(0x70);
+	section.push_back(5);
+	PutUtc(section, BASE_SECONDS + static_cast<unsigned long long>(Seconds()));
+	EmitSection(0x14, section);
+}
+
+// adaptation field only, does not advance the continuity counter
+void StreamGenerator::EmitPcr(unsigned pid) {
+	unsigned char* packet = NewPacket(pid, false);
+	continuity_[pid] = (continuity_[pid] + 15) & 0x0F;
+	packet[3] = static_cast<unsigned char>(0x20 | (packet[3] & 0x0F));
+	packet[4] = 183;
+	packet[5] = 0x10;
+
+	const double seconds = Seconds();
+	unsigned long long ticks = static_cast<unsigned long long>(seconds * 27000000.0);
+	if (config_.pcr_jump_ms && seconds * 1000 >= config_.pcr_jump_at_ms)
+		ticks += config_.pcr_jump_ms * 27000ULL;
+	const unsigned long long base = ticks / 300;
+	const unsigned extension = static_cast<unsigned>(ticks % 300);
+	packet[6] = static_cast<unsigned char>(base >> 25);
+	packet[7] = static_cast<unsigned char>(base >> 17);
+	packet[8] = static_cast<unsigned char>(base >> 9);
+	packet[9] = static_cast<unsigned char>(base >> 1);
+	packet[10] = static_cast<unsigned char>((base & 1) << 7 | 0x7E | extension >> 8);
+	packet[11] = static_cast<unsigned char>(extension);
+}
+
+// one PES per packet: page header plus two rows of the current page
+void StreamGenerator::EmitTeletext() {
+	unsigned char* packet = NewPacket(config_.teletext_pid, true);
+	unsigned char* p = packet + 4;
+
+	const unsigned long long pts = static_cast<unsigned long long>(Seconds() * 90000.0);
+	*p++ = 0x00; *p++ = 0x00; *p++ = 0x01; *p++ = 0xBD;
+	*p++ = 0x00; *p++ = 178;
+	*p++ = 0x84; *p++ = 0x80; *p++ = 36;
+	*p++ = static_cast<unsigned char>(0x21 | (pts >> 29 & 0x0E));
+	*p++ = static_cast<unsigned char>(pts >> 22);
+	*p++ = static_cast<unsigned char>(0x01 | (pts >> 14 & 0xFE));
+	*p++ = static_cast<unsigned char>(pts >> 7);
+	*p++ = static_cast<unsigned char>(0x01 | (pts << 1 & 0xFE));
+	std::memset(p, 0xFF, 31);
+	p += 31;
+	*p++ = 0x10;
+
+	const unsigned magazine = 1;
+	const unsigned page = teletext_page_ % 10;
+	++teletext_page_;
+
+	for (unsigned row = 0; row < 3; ++row) {
+		*p++ = 0x02;
+		*p++ = 44;
+		*p++ = static_cast<unsigned char>(0xE0 | (7 + row));
+		*p++ = 0xE4;
+		*p++ = Hamming(magazine | (row & 1) << 3);
+		*p++ = Hamming(row >> 1);
+
+		char text[41];
+		if (row == 0) {
+			*p++ = Hamming(page % 10);
+			*p++ = Hamming(page / 10);
+			*p++ = Hamming(0);
+			*p++ = Hamming(0x8);    // C4 erase page
+			*p++ = Hamming(0);
+			*p++ = Hamming(0);
+			*p++ = Hamming(0);
+			*p++ = Hamming(0);
+			std::sprintf(text, "tssibench 1%02u %20llu", page, static_cast<unsigned long long>(packets_));
+			for (unsigned i = 0; i < 32; ++i)
+				*p++ = OddParity(text[i] ? text[i] : ' ');
+		}
+		else {
+			const unsigned length = static_cast<unsigned>(std::sprintf(text, "Row %02u of page 1%02u, synthetic teletext", row, page));
+			for (unsigned i = 0; i < 40; ++i)
+				*p++ = OddParity(i < length ? text[i] : ' ');
+		}
+	}
+}
+
+// video and audio payload in a 3:1 ratio, round robin over services
+void StreamGenerator::EmitFiller() {
+	const unsigned service = filler_ / 4 % config_.services;
+	const unsigned pid = filler_ % 4 == 3 ? AudioPid(service) : VideoPid(service);
+	++filler_;
+	unsigned char* packet = NewPacket(pid, false);
+	std::memset(packet + 4, 0x00, 184);
+}
+
+double StreamGenerator::Seconds() const {
+	return static_cast<double>(packets_) * 188 * 8 / config_.bitrate;
+}
+
+}
@@ -0,0 +1,116 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TS_GENERATOR_H_INCLUDED__
+#define __TS_GENERATOR_H_INCLUDED__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace tssibench {
+
+// synthetic stream layout: service i has program number 28201 + i, PMT PID
+// 0x100 + 0x10 * i, video (and PCR) on PMT PID + 1, audio on PMT PID + 2;
+// teletext is announced in the PMT of the first service
+struct GeneratorConfig {
+	GeneratorConfig();
+
+	unsigned services;
+	unsigned events_per_service;   // EIT schedule, the first two are p/f
+	unsigned long bitrate;         // bit/s, fixes the time base
+	unsigned teletext_pid;         // 0: no teletext
+	unsigned pcr_interval_ms;
+	unsigned pcr_jump_ms;          // added to every PCR from pcr_jump_at_ms on, unsignalled
+	unsigned pcr_jump_at_ms;
+	unsigned psi_interval_ms;      // PAT and PMT repetition
+	unsigned si_interval_ms;       // SDT and EIT repetition
+	unsigned tdt_interval_ms;
+	unsigned teletext_interval_ms;
+	unsigned transport_stream_id;
+	unsigned original_network_id;
+	bool pack_sections;            // EIT sections share packets (pointer_field > 0)
+	bool schedule_present;         // the schedule repeats the p/f events, running status 0
+	unsigned version;              // version_number of all tables
+};
+
+class StreamGenerator {
+public:
+	explicit StreamGenerator(const GeneratorConfig& config);
+
+	// appends the next packets of the stream
+	void Generate(std::vector<unsigned char>& stream, std::size_t packets);
+
+	unsigned ProgramNumber(unsigned service) const { return 28201 + service; }
+	unsigned PmtPid(unsigned service) const { return 0x100 + 0x10 * service; }
+	unsigned VideoPid(unsigned service) const { return PmtPid(service) + 1; }
+	unsigned AudioPid(unsigned service) const { return PmtPid(service) + 2; }
+
+private:
+	typedef std::vector<unsigned char> Bytes;
+
+	struct Schedule {
+		unsigned long long interval;   // packets
+		unsigned long long next;
+	};
+
+	void BuildTables();
+	Bytes BuildPmt(unsigned service) const;
+	Bytes BuildSdt() const;
+	void BuildEit(unsigned service);
+
+	Schedule MakeSchedule(unsigned interval_ms, unsigned phase) const;
+	bool Due(Schedule& schedule);
+
+	// emits the next due table, PCR, teletext or filler packets
+	void Step();
+	void EmitSection(unsigned pid, const Bytes& section);
+	void EmitPacked(unsigned pid, const std::vector<Bytes>& sections);
+	void EmitTdt();
+	void EmitPcr(unsigned pid);
+	void EmitTeletext();
+	void EmitFiller();
+	unsigned char* NewPacket(unsigned pid, bool unit_start);
+
+	double Seconds() const;
+
+	GeneratorConfig config_;
+	unsigned long long packets_;
+	std::vector<unsigned char> continuity_;
+	Bytes pending_;
+
+	Bytes pat_;
+	std::vector<Bytes> pmts_;
+	Bytes sdt_;
+	std::vector<Bytes> eit_;
+
+	Schedule psi_;
+	Schedule si_;
+	Schedule tdt_;
+	Schedule pcr_;
+	Schedule teletext_;
+	unsigned teletext_page_;
+	unsigned filler_;
+};
+
+}
+
+#endif // __TS_GENERATOR_H_INCLUDED__
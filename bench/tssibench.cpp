@@ -0,0 +1,367 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+// Throughput benchmark: raw tssi::Parser::Process, the Python Parser.Process
+// wrapper and table getter access, on a synthetic stream.
+//
+//   tssibench [--megabytes N] [--services N] [--events N] [--bitrate N]
+//             [--repeat N] [--write FILE] [--min-ratio X]
+//
+// The Python module is compiled into this executable, so no installed
+// libtssipython is needed. --min-ratio fails the run if the wrapper reaches
+// less than the given fraction of raw parser throughput.
+
+#include <boost/python.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "tssi.h"
+#include "ts_generator.h"
+
+using namespace boost::python;
+
+#if PY_MAJOR_VERSION >= 3
+extern "C" PyObject* PyInit_libtssipython();
+#else
+extern "C" void initlibtssipython();
+#endif
+
+// every C++ allocation in the process, libtssi's and Boost.Python's included
+static std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+// Python object and buffer allocations (PyMem_Malloc, PyObject_Malloc and
+// friends) are counted separately; they never reach operator new. Hooking
+// needs PyMem_SetAllocator, so older interpreters report them as n/a.
+#if PY_VERSION_HEX >= 0x03040000
+#define TSSIBENCH_PYTHON_ALLOCATIONS
+static std::atomic<unsigned long long> python_allocations(0);
+static PyMemAllocatorEx python_mem, python_obj;
+
+static void* PythonMalloc(void* context, std::size_t size) {
+	python_allocations.fetch_add(1, std::memory_order_relaxed);
+	PyMemAllocatorEx* allocator = static_cast<PyMemAllocatorEx*>(context);
+	return allocator->malloc(allocator->ctx, size);
+}
+
+static void* PythonCalloc(void* context, std::size_t count, std::size_t size) {
+	python_allocations.fetch_add(1, std::memory_order_relaxed);
+	PyMemAllocatorEx* allocator = static_cast<PyMemAllocatorEx*>(context);
+	return allocator->calloc(allocator->ctx, count, size);
+}
+
+// realloc(NULL, size) is a fresh allocation, resizes are not counted
+static void* PythonRealloc(void* context, void* memory, std::size_t size) {
+	if (!memory)
+		python_allocations.fetch_add(1, std::memory_order_relaxed);
+	PyMemAllocatorEx* allocator = static_cast<PyMemAllocatorEx*>(context);
+	return allocator->realloc(allocator->ctx, memory, size);
+}
+
+static void PythonFree(void* context, void* memory) {
+	PyMemAllocatorEx* allocator = static_cast<PyMemAllocatorEx*>(context);
+	allocator->free(allocator->ctx, memory);
+}
+
+// wraps the installed allocators, so it may run after Py_Initialize
+static void HookPythonAllocators() {
+	PyMem_GetAllocator(PYMEM_DOMAIN_MEM, &python_mem);
+	PyMem_GetAllocator(PYMEM_DOMAIN_OBJ, &python_obj);
+	PyMemAllocatorEx mem = { &python_mem, PythonMalloc, PythonCalloc, PythonRealloc, PythonFree };
+	PyMemAllocatorEx obj = { &python_obj, PythonMalloc, PythonCalloc, PythonRealloc, PythonFree };
+	PyMem_SetAllocator(PYMEM_DOMAIN_MEM, &mem);
+	PyMem_SetAllocator(PYMEM_DOMAIN_OBJ, &obj);
+}
+#endif
+
+namespace {
+
+struct Options {
+	Options() : megabytes(64), repeat(5), min_ratio(0) {}
+
+	tssibench::GeneratorConfig generator;
+	unsigned megabytes;
+	unsigned repeat;
+	std::string write;
+	double min_ratio;
+};
+
+struct Measurement {
+	double seconds;
+	unsigned long long allocations;           // C++
+	unsigned long long python_allocations;
+};
+
+unsigned long long PythonAllocations() {
+#ifdef TSSIBENCH_PYTHON_ALLOCATIONS
+	return python_allocations.load();
+#else
+	return 0;
+#endif
+}
+
+// best of repeat runs
+template<class F> Measurement Measure(unsigned repeat, F run) {
+	Measurement best = { 0, 0, 0 };
+	for (unsigned i = 0; i < repeat; ++i) {
+		const unsigned long long before = allocations.load(), python_before = PythonAllocations();
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		run();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const unsigned long long count = allocations.load() - before, python_count = PythonAllocations() - python_before;
+		if (i == 0 || seconds < best.seconds) {
+			best.seconds = seconds;
+			best.allocations = count;
+			best.python_allocations = python_count;
+		}
+	}
+	return best;
+}
+
+// Python allocations per unit, n/a without allocator hooks
+std::string PythonPer(const Measurement& measurement, double units, const char* format) {
+#ifdef TSSIBENCH_PYTHON_ALLOCATIONS
+	char text[32];
+	std::snprintf(text, sizeof(text), format, units > 0 ? measurement.python_allocations / units : 0.0);
+	return text;
+#else
+	(void)measurement;
+	(void)units;
+	(void)format;
+	return "n/a";
+#endif
+}
+
+void ReportStream(const char* path, const Measurement& measurement, std::size_t bytes) {
+	const double megabytes = bytes / (1024.0 * 1024.0);
+	std::printf("%-32s %10.1f MB/s %12.0f packets/s %10.1f C++ allocs/MB %10s Python allocs/MB\n", path,
+		megabytes / measurement.seconds, bytes / 188 / measurement.seconds, measurement.allocations / megabytes,
+		PythonPer(measurement, megabytes, "%.1f").c_str());
+}
+
+void ReportEntries(const char* path, const Measurement& measurement, unsigned long long entries) {
+	std::printf("%-32s %10.0f entries/s %10.2f C++ allocs/entry %10s Python allocs/entry\n", path,
+		entries / measurement.seconds, entries ? static_cast<double>(measurement.allocations) / entries : 0.0,
+		PythonPer(measurement, static_cast<double>(entries), "%.2f").c_str());
+}
+
+// walks EIT and SDT the way a program guide would
+unsigned long long NativeGetters(tssi::Parser& parser) {
+	unsigned long long entries = 0, checksum = 0;
+	tssi::Table_Eit& eit = parser.TableEit();
+	for (unsigned i = 0; i < eit.GetEventListLength(); ++i, ++entries) {
+		const tssi::EitEvent& event = eit.GetEvent(i);
+		checksum += event.service_id + event.event_id + event.start_time + event.duration;
+		const tssi::Descriptor_ShortEvent* short_event = dynamic_cast<const tssi::Descriptor_ShortEvent*>(event.descriptor_list.GetDescriptorByTag(0x4d));
+		if (short_event)
+			checksum += short_event->GetEventName().size();
+	}
+	tssi::Table_Sdt& sdt = parser.TableSdt();
+	for (unsigned i = 0; i < sdt.GetServiceListLength(); ++i, ++entries) {
+		const tssi::ServiceDescription& service = sdt.GetServiceDescription(i);
+		const tssi::Descriptor_Service* descriptor = dynamic_cast<const tssi::Descriptor_Service*>(service.descriptor_list.GetDescriptorByTag(0x48));
+		checksum += service.service_id + (descriptor ? descriptor->GetServiceName().size() : 0);
+	}
+	if (checksum == 0)
+		std::printf("tables are empty\n");
+	return entries;
+}
+
+const char* PYTHON_PATHS =
+	"import libtssipython\n"
+	"\n"
+	"def process(data):\n"
+	"    parser = libtssipython.Parser()\n"
+	"    parser.Process(data)\n"
+	"    return parser\n"
+	"\n"
+	"def filtered(data, services):\n"
+	"    parser = libtssipython.Parser()\n"
+	"    parser.SetPidFilter(allow=[0x00, 0x10, 0x11, 0x12, 0x14] + [0x100 + 0x10 * i for i in range(services)])\n"
+	"    parser.Process(data)\n"
+	"    return parser\n"
+	"\n"
+	"def getters(parser):\n"
+	"    entries = 0\n"
+	"    eit = parser.TableEit()\n"
+	"    for i in range(eit.GetEventListLength()):\n"
+	"        event = eit.GetEvent(i)\n"
+	"        event.service_id, event.event_id, event.start_time, event.duration\n"
+	"        descriptor = event.descriptor_list.GetDescriptorByTag(0x4d)\n"
+	"        if descriptor is not None:\n"
+	"            descriptor.GetEventName()\n"
+	"        entries += 1\n"
+	"    sdt = parser.TableSdt()\n"
+	"    for i in range(sdt.GetServiceListLength()):\n"
+	"        service = sdt.GetServiceDescription(i)\n"
+	"        service.service_id\n"
+	"        descriptor = service.descriptor_list.GetDescriptorByTag(0x48)\n"
+	"        if descriptor is not None:\n"
+	"            descriptor.GetServiceName()\n"
+	"        entries += 1\n"
+	"    return entries\n"
+	"\n"
+	"def columns(parser):\n"
+	"    return len(parser.TableEit().GetEventColumns()['event_id'])\n";
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string option = argv[i];
+		if (i + 1 >= argc) {
+			std::fprintf(stderr, "missing value for %s\n", option.c_str());
+			return false;
+		}
+		const char* value = argv[++i];
+		if (option == "--megabytes")
+			options.megabytes = static_cast<unsigned>(std::atoi(value));
+		else if (option == "--services")
+			options.generator.services = static_cast<unsigned>(std::atoi(value));
+		else if (option == "--events")
+			options.generator.events_per_service = static_cast<unsigned>(std::atoi(value));
+		else if (option == "--bitrate")
+			options.generator.bitrate = std::strtoul(value, 0, 10);
+		else if (option == "--teletext-pid")
+			options.generator.teletext_pid = static_cast<unsigned>(std::strtoul(value, 0, 0));
+		else if (option == "--repeat")
+			options.repeat = std::max(1, std::atoi(value));
+		else if (option == "--write")
+			options.write = value;
+		else if (option == "--min-ratio")
+			options.min_ratio = std::atof(value);
+		else {
+			std::fprintf(stderr, "unknown option %s\n", option.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+		return 2;
+
+	std::vector<unsigned char> stream;
+	{
+		tssibench::StreamGenerator generator(options.generator);
+		generator.Generate(stream, static_cast<std::size_t>(options.megabytes) * 1024 * 1024 / 188);
+	}
+	std::printf("stream: %.1f MB, %lu packets, %u services, %u events/service, %lu bit/s\n",
+		stream.size() / (1024.0 * 1024.0), static_cast<unsigned long>(stream.size() / 188),
+		options.generator.services, options.generator.events_per_service, options.generator.bitrate);
+
+	if (!options.write.empty()) {
+		std::FILE* file = std::fopen(options.write.c_str(), "wb");
+		if (!file || std::fwrite(&stream[0], 1, stream.size(), file) != stream.size()) {
+			std::perror(options.write.c_str());
+			return 1;
+		}
+		std::fclose(file);
+	}
+
+	// raw parser
+	const Measurement raw = Measure(options.repeat, [&]() {
+		tssi::Parser parser;
+		parser.Process(&stream[0], static_cast<unsigned>(stream.size()));
+	});
+	ReportStream("tssi::Parser::Process", raw, stream.size());
+
+	tssi::Parser parsed;
+	parsed.Process(&stream[0], static_cast<unsigned>(stream.size()));
+	unsigned long long native_entries = 0;
+	const Measurement native_getters = Measure(options.repeat, [&]() { native_entries = NativeGetters(parsed); });
+
+	// Python wrapper
+#if PY_MAJOR_VERSION >= 3
+	PyImport_AppendInittab("libtssipython", &PyInit_libtssipython);
+#else
+	PyImport_AppendInittab(const_cast<char*>("libtssipython"), &initlibtssipython);
+#endif
+	Py_Initialize();
+#ifdef TSSIBENCH_PYTHON_ALLOCATIONS
+	HookPythonAllocators();
+#endif
+
+	int status = 0;
+	try {
+		object main_namespace = import("__main__").attr("__dict__");
+		exec(PYTHON_PATHS, main_namespace);
+		object data(handle<>(PyByteArray_FromStringAndSize(reinterpret_cast<const char*>(&stream[0]), static_cast<Py_ssize_t>(stream.size()))));
+
+		object process = main_namespace["process"];
+		const Measurement wrapper = Measure(options.repeat, [&]() { process(data); });
+		ReportStream("Parser.Process (Python)", wrapper, stream.size());
+
+		// PSI/SI only, video and audio dropped by the prescan
+		object filtered = main_namespace["filtered"];
+		const Measurement prescan = Measure(options.repeat, [&]() { filtered(data, options.generator.services); });
+		ReportStream("Parser.Process (PID filter)", prescan, stream.size());
+
+		object parser = process(data);
+		object getters = main_namespace["getters"];
+		object columns = main_namespace["columns"];
+		unsigned long long python_entries = 0, column_entries = 0;
+		const Measurement python_getters = Measure(options.repeat, [&]() { python_entries = extract<unsigned long long>(getters(parser)); });
+		const Measurement column_getters = Measure(options.repeat, [&]() { column_entries = extract<unsigned long long>(columns(parser)); });
+
+		ReportEntries("EIT/SDT getters (native)", native_getters, native_entries);
+		ReportEntries("EIT/SDT getters (Python)", python_getters, python_entries);
+		ReportEntries("Table_Eit.GetEventColumns", column_getters, column_entries);
+
+		const double ratio = raw.seconds / wrapper.seconds;
+		std::printf("wrapper/raw throughput ratio %.3f\n", ratio);
+		if (options.min_ratio > 0 && ratio < options.min_ratio) {
+			std::printf("FAIL: ratio below %.3f\n", options.min_ratio);
+			status = 1;
+		}
+	}
+	catch (const error_already_set&) {
+		PyErr_Print();
+		status = 1;
+	}
+	return status;
+}
@@ -0,0 +1,30 @@
+#
+#    libtssipython - Python wrapper for libtssi
+#    synthetic test streams from the benchmark generator (module tsgen)
+#
+
+import tsgen
+
+
+def generator(**fields):
+    config = tsgen.GeneratorConfig()
+    for name, value in fields.items():
+        setattr(config, name, value)
+    return tsgen.StreamGenerator(config)
+
+
+def generate(packets, **fields):
+    return generator(**fields).Generate(packets)
+
+
+# packets for the given seconds of a stream at the default bitrate
+def packets(seconds, bitrate=20000000):
+    return int(seconds * bitrate / (188 * 8))
+
+
+# the packets of one PID, as bytearrays
+def packets_of(stream, pid):
+    for offset in range(0, len(stream), 188):
+        packet = bytearray(stream[offset:offset + 188])
+        if ((packet[1] & 0x1F) << 8 | packet[2]) == pid:
+            yield packet
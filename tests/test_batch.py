@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    process_files on the native thread pool
+
+from __future__ import print_function
+
+import errno
+import os
+import shutil
+import tempfile
+import unittest
+
+import libtssipython
+import streams
+
+
+class BatchTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        # different sizes, so largest first reorders the work
+        cls.directory = tempfile.mkdtemp()
+        cls.paths = []
+        for i, seconds in enumerate([0.6, 2.0, 1.0, 0.6, 1.4]):
+            path = os.path.join(cls.directory, "stream%d.ts" % i)
+            with open(path, "wb") as file:
+                file.write(streams.generate(streams.packets(seconds), services=i + 1, transport_stream_id=100 + i))
+            cls.paths.append(path)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.directory)
+
+    def test_results_in_input_order(self):
+        for threads in (1, 2, 8):
+            results = libtssipython.process_files(self.paths, threads=threads)
+            self.assertEqual([result["path"] for result in results], self.paths)
+            for i, result in enumerate(results):
+                self.assertIsNone(result["error"])
+                self.assertEqual(result["bytes"], os.path.getsize(self.paths[i]))
+                self.assertEqual(result["pat"]["transport_stream_id"], 100 + i)
+                self.assertEqual(len(result["pat"]["programs"]), i + 1)
+                self.assertEqual(len(result["sdt"]), i + 1)
+
+    def test_matches_parser(self):
+        results = libtssipython.process_files(self.paths, threads=3)
+        for path, result in zip(self.paths, results):
+            parser = libtssipython.Parser()
+            parser.ProcessFile(path)
+            self.assertEqual(result["packets_processed"], parser.PacketsProcessed())
+            self.assertEqual(result["processing_errors"], parser.ProcessingErrors())
+            self.assertEqual(result["eit"]["events"], parser.TableEit().GetEventListLength())
+            self.assertEqual(sorted(service["service_name"] for service in result["sdt"]),
+                             sorted("Service %d" % (i + 1) for i in range(len(result["sdt"]))))
+            self.assertEqual(result["sdt"][0]["provider_name"], "tssibench")
+
+    def test_missing_file(self):
+        missing = os.path.join(self.directory, "missing.ts")
+        results = libtssipython.process_files([self.paths[0], missing], threads=2)
+        self.assertIsNone(results[0]["error"])
+        self.assertEqual(results[1]["error"], os.strerror(errno.ENOENT))
+        self.assertEqual(results[1]["packets_processed"], 0)
+
+    def test_pids(self):
+        results = libtssipython.process_files(self.paths[:1], pids={"ebu": 0x404, "pcr": 0x101})
+        self.assertIsNone(results[0]["error"])
+        self.assertGreater(results[0]["packets_processed"], 0)
+
+    def test_thread_count_range(self):
+        self.assertRaises(ValueError, libtssipython.process_files, self.paths, threads=-1)
+        self.assertRaises(ValueError, libtssipython.process_files, self.paths, threads=1 << 32)
+        self.assertEqual(len(libtssipython.process_files(self.paths, threads=1024)), len(self.paths))
+
+    def test_no_files(self):
+        self.assertEqual(libtssipython.process_files([]), [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    section driven change tracking
+
+from __future__ import print_function
+
+import unittest
+
+import libtssipython
+import streams
+
+ONID, TSID = 1, 1073
+
+
+class ChangeTest(unittest.TestCase):
+
+    def test_initial_entries(self):
+        parser = libtssipython.Parser()
+        tracker = libtssipython.ChangeTracker(parser)
+        parser.Process(streams.generate(streams.packets(1.2), services=3, events_per_service=12))
+
+        sdt = tracker.GetChanges("SDT")
+        self.assertFalse(sdt["full"])
+        self.assertGreater(sdt["generation"], 0)
+        self.assertEqual(sorted(sdt["added"]), [(ONID, TSID, 28201 + i) for i in range(3)])
+        self.assertEqual(sdt["updated"], [])
+        self.assertEqual(sdt["removed"], [])
+
+        eit = tracker.GetChanges("EIT")
+        self.assertEqual(len(eit["added"]), 3 * 12)
+        self.assertIn((ONID, TSID, 28201, 1), eit["added"])
+        # the program itself, then its elementary streams
+        self.assertEqual(sorted(tracker.GetChanges("PMT")["added"])[:4],
+                         [(28201,), (28201, 0x101), (28201, 0x102), (28201, 0x404)])
+
+    def test_repeated_sections_change_nothing(self):
+        parser = libtssipython.Parser()
+        tracker = libtssipython.ChangeTracker(parser)
+        generator = streams.generator(services=3, events_per_service=12, schedule_present=True)
+        parser.Process(generator.Generate(streams.packets(1.2)))
+        generations = dict((table, tracker.Generation(table)) for table in ["SDT", "EIT", "PMT"])
+        self.assertEqual(len(tracker.GetChanges("EIT")["added"]), 3 * 12)
+
+        # p/f and schedule carry the first two events with different
+        # running status; p/f wins, so repetitions do not flip them
+        for _ in range(3):
+            parser.Process(generator.Generate(streams.packets(1.2)))
+        for table, generation in generations.items():
+            self.assertEqual(tracker.Generation(table), generation)
+            changes = tracker.GetChanges(table, since=generation)
+            self.assertEqual(changes["added"] + changes["updated"] + changes["removed"], [])
+
+    def test_new_version(self):
+        parser = libtssipython.Parser()
+        tracker = libtssipython.ChangeTracker(parser)
+        parser.Process(streams.generate(streams.packets(1.2), services=3, events_per_service=12))
+        sdt = tracker.Generation("SDT")
+        eit = tracker.Generation("EIT")
+
+        parser.Process(streams.generate(streams.packets(1.2), services=2, events_per_service=4, version=1))
+        changes = tracker.GetChanges("SDT", since=sdt)
+        self.assertEqual(changes["removed"], [(ONID, TSID, 28203)])
+        self.assertEqual(changes["added"] + changes["updated"], [])
+
+        changes = tracker.GetChanges("EIT", since=eit)
+        self.assertEqual(sorted(changes["removed"]),
+                         sorted((ONID, TSID, 28201 + s, e) for s in range(2) for e in range(5, 13)))
+        self.assertEqual(changes["added"], [])
+        self.assertEqual(tracker.GetChanges("EIT", since=changes["generation"])["removed"], [])
+
+    def test_added_and_removed_since(self):
+        parser = libtssipython.Parser()
+        tracker = libtssipython.ChangeTracker(parser)
+        parser.Process(streams.generate(streams.packets(1.2), services=3))
+        since = tracker.Generation("SDT")
+
+        # a service that comes and goes after since was never seen
+        parser.Process(streams.generate(streams.packets(1.2), services=4, version=1))
+        self.assertEqual(tracker.GetChanges("SDT", since=since)["added"], [(ONID, TSID, 28204)])
+        parser.Process(streams.generate(streams.packets(1.2), services=3, version=2))
+        changes = tracker.GetChanges("SDT", since=since)
+        self.assertGreater(changes["generation"], since)
+        self.assertEqual(changes["added"] + changes["updated"] + changes["removed"], [])
+
+    def test_unknown_table(self):
+        tracker = libtssipython.ChangeTracker(libtssipython.Parser())
+        self.assertRaises(ValueError, tracker.GetChanges, "TDT")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Table_Eit.GetEventColumns against per-event access
+
+from __future__ import print_function
+
+import array
+import sys
+import unittest
+
+import libtssipython
+import streams
+
+NUMERIC = ["transport_stream_id", "original_network_id", "service_id", "event_id",
+           "start_time", "duration", "running_status", "free_ca_mode"]
+
+
+class ColumnTest(unittest.TestCase):
+
+    def test_columns_match_events(self):
+        parser = libtssipython.Parser()
+        parser.Process(streams.generate(streams.packets(1.2), services=3, events_per_service=12))
+        eit = parser.TableEit()
+        columns = eit.GetEventColumns()
+        length = eit.GetEventListLength()
+        self.assertEqual(length, 3 * 12)
+        self.assertEqual(sorted(columns.keys()), sorted(NUMERIC + ["name", "text"]))
+
+        for name in NUMERIC:
+            self.assertIsInstance(columns[name], array.array)
+            self.assertEqual(len(columns[name]), length)
+        for i in range(length):
+            event = eit.GetEvent(i)
+            for name in NUMERIC:
+                self.assertEqual(columns[name][i], getattr(event, name))
+            descriptor = event.descriptor_list.GetDescriptorByTag(0x4d)
+            self.assertEqual(columns["name"][i], descriptor.GetEventName())
+            self.assertEqual(columns["text"][i], descriptor.GetEventText())
+            self.assertEqual(columns["name"][i], "Event %d of service %d"
+                             % (columns["event_id"][i], columns["service_id"][i] - 28200))
+
+    def test_empty_table(self):
+        columns = libtssipython.Parser().TableEit().GetEventColumns()
+        self.assertEqual(len(columns["event_id"]), 0)
+        self.assertEqual(columns["name"], [])
+
+    @unittest.skipIf(sys.version_info[0] < 3, "array.array has no memoryview on Python 2")
+    def test_buffer_protocol(self):
+        parser = libtssipython.Parser()
+        parser.Process(streams.generate(streams.packets(1.2), services=2))
+        column = parser.TableEit().GetEventColumns()["service_id"]
+        view = memoryview(column)
+        self.assertEqual(view.itemsize, column.itemsize)
+        self.assertEqual(len(view), len(column))
+
+
+if __name__ == "__main__":
+    unittest.main()
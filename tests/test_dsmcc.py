@@ -0,0 +1,65 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    DsmccDecoder threads and their bounded packet queues
+
+from __future__ import print_function
+
+import shutil
+import tempfile
+import unittest
+
+import libtssipython
+import streams
+
+
+class DsmccTest(unittest.TestCase):
+
+    def setUp(self):
+        # the generator has no carousel; video packets stand in for one,
+        # so the carousel threads get data but decode nothing
+        self.generator = streams.generator(services=2)
+        self.stream = self.generator.Generate(streams.packets(1.0))
+        self.pid = self.generator.VideoPid(0)
+        self.directory = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def test_queue(self):
+        parser = libtssipython.Parser()
+        decoder = libtssipython.DsmccDecoder(parser, [self.pid, self.generator.VideoPid(1)], output=self.directory)
+        parser.Process(self.stream)
+        self.assertTrue(decoder.Wait(10.0))
+        self.assertEqual(decoder.Dropped(), 0)
+        self.assertEqual(decoder.PollCompleted(), [])
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), 2)
+        decoder.Stop()
+        decoder.Stop()
+
+    def test_full_queue_drops(self):
+        parser = libtssipython.Parser()
+        decoder = libtssipython.DsmccDecoder(parser, [self.pid], output=self.directory, queue_packets=4)
+        parser.Process(self.stream)
+        carousel = len(list(streams.packets_of(self.stream, self.pid)))
+        # one buffer is handed over at once, only four packets fit
+        self.assertEqual(decoder.Dropped(), carousel - 4)
+        self.assertTrue(decoder.Wait(10.0))
+        decoder.Stop()
+
+    def test_stop_while_processing(self):
+        parser = libtssipython.Parser()
+        decoder = libtssipython.DsmccDecoder(parser, [self.pid])
+        chunk = 188 * 256
+        for offset in range(0, len(self.stream), chunk):
+            parser.Process(self.stream[offset:offset + chunk])
+            if offset >= len(self.stream) // 2:
+                decoder.Stop()
+        self.assertEqual(parser.PacketsProcessed(), len(self.stream) // 188)
+
+    def test_no_pids(self):
+        self.assertRaises(ValueError, libtssipython.DsmccDecoder, libtssipython.Parser(), [])
+
+
+if __name__ == "__main__":
+    unittest.main()
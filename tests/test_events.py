@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    table callbacks, queued events and their attribution to sections
+
+from __future__ import print_function
+
+import gc
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+TABLES = ["PAT", "PMT", "SDT", "EIT"]
+
+
+def queued_events(stream, sources=TABLES):
+    parser = libtssipython.Parser()
+    parser.QueueEvents(sources)
+    parser.Process(stream)
+    return parser.PollEvents()
+
+
+class EventTest(unittest.TestCase):
+
+    def test_callbacks_are_kept(self):
+        parser = libtssipython.Parser()
+        calls = []
+        parser.TableSdt().SetProcessCallback(lambda: calls.append("SDT"))
+        parser.TablePat().SetProcessCallback(lambda: calls.append("PAT"))
+        gc.collect()
+        parser.Process(streams.generate(streams.packets(0.6)))
+        self.assertIn("SDT", calls)
+        self.assertIn("PAT", calls)
+
+        del calls[:]
+        parser.TableSdt().SetProcessCallback(None)
+        parser.Reset()
+        parser.Process(streams.generate(streams.packets(0.6)))
+        self.assertNotIn("SDT", calls)
+
+    def test_callback_errors_do_not_stop_processing(self):
+        parser = libtssipython.Parser()
+
+        def fail():
+            raise RuntimeError("callback error")
+
+        parser.TablePat().SetProcessCallback(fail)
+        stream = streams.generate(streams.packets(0.6), services=2)
+        parser.Process(stream)
+        self.assertEqual(parser.PacketsProcessed(), len(stream) // 188)
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), 2)
+
+    def test_attribution(self):
+        generator = streams.generator(services=3)
+        events = queued_events(generator.Generate(streams.packets(0.6)))
+        expected = {"PAT": (0x00, [0x00]), "SDT": (0x11, [0x42]), "EIT": (0x12, [0x4E, 0x50])}
+        pmt_pids = [generator.PmtPid(i) for i in range(3)]
+        seen = set()
+        for source, pid, table_id, version, pcr in events:
+            seen.add(source)
+            self.assertEqual(version, 0)
+            self.assertIsNone(pcr)
+            if source == "PMT":
+                self.assertIn(pid, pmt_pids)
+                self.assertEqual(table_id, 0x02)
+            else:
+                self.assertEqual(pid, expected[source][0])
+                self.assertIn(table_id, expected[source][1])
+        self.assertEqual(seen, set(TABLES))
+
+    def test_attribution_with_packed_sections(self):
+        # EIT sections sharing packets must be attributed exactly like
+        # sections that each start a packet
+        one_cycle = streams.packets(0.3)
+        separate = queued_events(streams.generate(one_cycle, services=4), ["EIT"])
+        packed_stream = streams.generate(one_cycle, services=4, pack_sections=True)
+        packed = queued_events(packed_stream, ["EIT"])
+        self.assertTrue(any(packet[1] & 0x40 and packet[4] > 0
+                            for packet in streams.packets_of(packed_stream, 0x12)))
+        self.assertGreater(len(separate), 0)
+        self.assertEqual(packed, separate)
+        self.assertIn(0x50, [table_id for _, _, table_id, _, _ in packed])
+
+    def test_event_callback(self):
+        parser = libtssipython.Parser()
+        batches = []
+        parser.QueueEvents(["SDT"])
+        parser.SetEventCallback(batches.append)
+        parser.Process(streams.generate(streams.packets(0.6)))
+        self.assertGreater(len(batches), 0)
+        self.assertTrue(all(event[0] == "SDT" for batch in batches for event in batch))
+        self.assertEqual(parser.PollEvents(), [])
+        self.assertRaises(ValueError, parser.QueueEvents, ["XYZ"])
+
+    def test_observers_while_processing(self):
+        # native observers and taps come and go while another thread parses
+        parser = libtssipython.Parser()
+        stream = streams.generate(streams.packets(1.0), services=4)
+        done = threading.Event()
+
+        def process():
+            while not done.is_set():
+                parser.Process(stream)
+
+        worker = threading.Thread(target=process)
+        worker.start()
+        try:
+            for _ in range(200):
+                pipeline = libtssipython.Pipeline(parser)
+                tracker = libtssipython.ChangeTracker(parser)
+                monitor = libtssipython.PcrMonitor(parser)
+                del pipeline, tracker, monitor
+                gc.collect()
+        finally:
+            done.set()
+            worker.join()
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), 4)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    the synthetic stream generator behind tssibench and these tests
+
+from __future__ import print_function
+
+import unittest
+
+import streams
+
+
+# CRC-32/MPEG-2, 0 over a section including its CRC
+def crc32(data):
+    crc = 0xFFFFFFFF
+    for byte in bytearray(data):
+        crc ^= byte << 24
+        for _ in range(8):
+            crc = (crc << 1) ^ 0x04C11DB7 if crc & 0x80000000 else crc << 1
+        crc &= 0xFFFFFFFF
+    return crc
+
+
+# sections of one PID, assuming no section starts behind a pointer_field
+def sections_of(stream, pid):
+    data = None
+    for packet in streams.packets_of(stream, pid):
+        if packet[1] & 0x40:
+            data = packet[5 + packet[4]:]
+        elif data is not None:
+            data += packet[4:]
+        while data is not None and len(data) >= 3 and data[0] != 0xFF:
+            length = 3 + ((data[1] & 0x0F) << 8 | data[2])
+            if len(data) < length:
+                break
+            yield bytes(data[:length])
+            data = data[length:]
+
+
+class GeneratorTest(unittest.TestCase):
+
+    def test_packets(self):
+        stream = streams.generate(1000)
+        self.assertEqual(len(stream), 1000 * 188)
+        continuity = {}
+        for offset in range(0, len(stream), 188):
+            packet = bytearray(stream[offset:offset + 188])
+            self.assertEqual(packet[0], 0x47)
+            pid = (packet[1] & 0x1F) << 8 | packet[2]
+            if pid == 0x1FFF or not packet[3] & 0x10:
+                continue
+            counter = packet[3] & 0x0F
+            if pid in continuity:
+                self.assertEqual(counter, (continuity[pid] + 1) & 0x0F)
+            continuity[pid] = counter
+
+    def test_sections(self):
+        generator = streams.generator(services=3, events_per_service=12, version=5)
+        stream = generator.Generate(streams.packets(1.2))
+        for pid, table_ids in [(0x00, [0x00]), (0x11, [0x42]), (0x12, [0x4E, 0x50]),
+                               (generator.PmtPid(2), [0x02])]:
+            sections = list(sections_of(stream, pid))
+            self.assertTrue(sections, "no sections on PID %d" % pid)
+            for section in sections:
+                section = bytearray(section)
+                self.assertIn(section[0], table_ids)
+                self.assertEqual(crc32(section), 0)
+                self.assertEqual((section[5] >> 1) & 0x1F, 5)
+
+    def test_schedule_present(self):
+        def schedule_events(**fields):
+            events = set()
+            for section in sections_of(streams.generate(streams.packets(1.2), **fields), 0x12):
+                section = bytearray(section)
+                position = 14
+                while section[0] == 0x50 and position < len(section) - 4:
+                    events.add(section[position] << 8 | section[position + 1])
+                    position += 12 + ((section[position + 10] & 0x0F) << 8 | section[position + 11])
+            return events
+
+        self.assertEqual(schedule_events(services=1, events_per_service=6), set([3, 4, 5, 6]))
+        self.assertEqual(schedule_events(services=1, events_per_service=6, schedule_present=True),
+                         set(range(1, 7)))
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    indexed SDT and EIT lookups
+
+from __future__ import print_function
+
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+# start of the first generated event, seconds since 1970
+FIRST_START = (57689 - 40587) * 86400 + 20 * 3600
+DURATION = 30 * 60
+
+
+class IndexTest(unittest.TestCase):
+
+    def setUp(self):
+        self.generator = streams.generator(services=3, events_per_service=12)
+        self.parser = libtssipython.Parser()
+        self.parser.Process(self.generator.Generate(streams.packets(1.2)))
+        self.sdt = self.parser.TableSdt()
+        self.eit = self.parser.TableEit()
+
+    def test_find_service(self):
+        for i in range(3):
+            service = self.sdt.FindService(28201 + i)
+            self.assertEqual(service.service_id, 28201 + i)
+            self.assertEqual(service.descriptor_list.GetDescriptorByTag(0x48).GetServiceName(), "Service %d" % (i + 1))
+        self.assertIsNotNone(self.sdt.FindService(28201, original_network_id=1, transport_stream_id=1073))
+        self.assertIsNone(self.sdt.FindService(28201, transport_stream_id=1074))
+        self.assertIsNone(self.sdt.FindService(28204))
+
+    def test_find_event(self):
+        event = self.eit.FindEvent(28202, 5)
+        self.assertEqual((event.service_id, event.event_id), (28202, 5))
+        self.assertIsNotNone(self.eit.FindEvent(28202, 1, original_network_id=1))
+        self.assertIsNone(self.eit.FindEvent(28202, 1, original_network_id=2))
+        self.assertIsNone(self.eit.FindEvent(28202, 13))
+
+    def test_find_events(self):
+        start = FIRST_START + 3 * DURATION
+        events = self.eit.FindEvents(28203, start=start, end=start + 2 * DURATION)
+        self.assertEqual([event.event_id for event in events], [4, 5])
+        # an event overlapping the window start counts
+        events = self.eit.FindEvents(28203, start=start + 60, end=start + 120)
+        self.assertEqual([event.event_id for event in events], [4])
+        self.assertEqual(len(self.eit.FindEvents(28203)), 12)
+        self.assertEqual(self.eit.FindEvents(28204), [])
+
+    def test_repeated_sections_keep_results(self):
+        before = [self.eit.FindEvent(28201, i).event_id for i in range(1, 13)]
+        for _ in range(3):
+            self.parser.Process(self.generator.Generate(streams.packets(1.2)))
+            self.assertEqual([self.eit.FindEvent(28201, i).event_id for i in range(1, 13)], before)
+
+    def test_reset(self):
+        self.assertIsNotNone(self.sdt.FindService(28201))
+        self.parser.Reset()
+        self.assertIsNone(self.sdt.FindService(28201))
+        self.parser.Process(streams.generate(streams.packets(1.2), services=4, transport_stream_id=1074))
+        self.assertIsNotNone(self.sdt.FindService(28204, transport_stream_id=1074))
+        self.assertIsNone(self.sdt.FindService(28201, transport_stream_id=1073))
+
+    def test_lookup_while_processing(self):
+        stream = self.generator.Generate(streams.packets(2.0))
+        chunk = 188 * 256
+        done = threading.Event()
+
+        def process():
+            for offset in range(0, len(stream), chunk):
+                self.parser.Process(stream[offset:offset + chunk])
+            done.set()
+
+        worker = threading.Thread(target=process)
+        worker.start()
+        while not done.is_set():
+            self.assertEqual(self.sdt.FindService(28202).service_id, 28202)
+            event = self.eit.FindEvent(28203, 7)
+            self.assertEqual((event.service_id, event.event_id), (28203, 7))
+            events = self.eit.FindEvents(28202)
+            self.assertEqual([(event.service_id, event.event_id) for event in events], [(28202, i) for i in range(1, 13)])
+        worker.join()
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Parser.ProcessFile and Parser.ProcessFd with mapped and chunked reads
+
+from __future__ import print_function
+
+import os
+import shutil
+import tempfile
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+
+class IngestTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.stream = streams.generate(streams.packets(1.0), services=2)
+        cls.directory = tempfile.mkdtemp()
+        cls.path = os.path.join(cls.directory, "stream.ts")
+        with open(cls.path, "wb") as file:
+            file.write(cls.stream)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.directory)
+
+    def test_file_chunks(self):
+        # chunk sizes are rounded to whole packets
+        for chunk_size in (188, 1000, 188 * 4096):
+            parser = libtssipython.Parser()
+            self.assertEqual(parser.ProcessFile(self.path, chunk_size=chunk_size), (len(self.stream), 1))
+            self.assertEqual(parser.PacketsProcessed(), len(self.stream) // 188)
+            self.assertEqual(parser.TableSdt().GetServiceListLength(), 2)
+
+    def test_file_range(self):
+        parser = libtssipython.Parser()
+        offset, length = 188 * 100, 188 * 500
+        self.assertEqual(parser.ProcessFile(self.path, offset=offset, length=length), (length, 1))
+        self.assertEqual(parser.PacketsProcessed(), 500)
+
+        parser = libtssipython.Parser()
+        self.assertEqual(parser.ProcessFile(self.path, offset=len(self.stream) - 188), (188, 1))
+        self.assertEqual(parser.ProcessFile(self.path, offset=len(self.stream) + 188), (0, 1))
+
+    def test_missing_file(self):
+        parser = libtssipython.Parser()
+        self.assertRaises(IOError, parser.ProcessFile, os.path.join(self.directory, "missing.ts"))
+
+    def test_pipe(self):
+        # odd write sizes split packets, the reader carries fragments over
+        read_end, write_end = os.pipe()
+
+        def write():
+            position = 0
+            while position < len(self.stream):
+                position += os.write(write_end, self.stream[position:position + 1001])
+            os.close(write_end)
+
+        writer = threading.Thread(target=write)
+        writer.start()
+        try:
+            parser = libtssipython.Parser()
+            self.assertEqual(parser.ProcessFd(read_end, chunk_size=188 * 16), (len(self.stream), 1))
+        finally:
+            writer.join()
+            os.close(read_end)
+        self.assertEqual(parser.PacketsProcessed(), len(self.stream) // 188)
+        self.assertEqual(parser.TablePat().GetProgramListLength(), 2)
+
+    def test_file_object(self):
+        # the descriptor starts at tell(), not behind the read-ahead buffer
+        parser = libtssipython.Parser()
+        with open(self.path, "rb") as file:
+            file.seek(188 * 10)
+            self.assertEqual(file.read(188), self.stream[188 * 10:188 * 11])
+            self.assertEqual(parser.ProcessFd(file, length=188 * 20), (188 * 20, 1))
+            self.assertEqual(file.tell(), 188 * 31)
+            self.assertEqual(file.read(188), self.stream[188 * 31:188 * 32])
+        self.assertEqual(parser.PacketsProcessed(), 20)
+
+    def test_unseekable_file_object(self):
+        read_end, write_end = os.pipe()
+        os.close(write_end)
+        with os.fdopen(read_end, "rb") as file:
+            self.assertRaises(ValueError, libtssipython.Parser().ProcessFd, file)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,118 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    PcrMonitor slices, reference clock and discontinuities
+
+from __future__ import print_function
+
+import unittest
+
+import libtssipython
+import streams
+
+
+class PcrTest(unittest.TestCase):
+
+    def setUp(self):
+        self.generator = streams.generator(services=2)
+        self.stream = self.generator.Generate(streams.packets(2.5))
+
+    def test_bitrates(self):
+        parser = libtssipython.Parser()
+        monitor = libtssipython.PcrMonitor(parser, window=1.0, slices=4)
+        parser.Process(self.stream)
+        snapshot = monitor.Snapshot()
+        # slices close on the interpolated clock, at exact boundaries
+        self.assertEqual(snapshot["slices"], 4)
+        self.assertAlmostEqual(snapshot["seconds"], 1.0, places=6)
+        self.assertAlmostEqual(snapshot["clock"], 2.46, delta=0.05)
+        self.assertEqual(snapshot["discarded"], 0)
+        self.assertAlmostEqual(snapshot["bitrate"] / 20000000, 1.0, delta=0.01)
+
+        for service in range(2):
+            program = snapshot["programs"][self.generator.ProgramNumber(service)]
+            self.assertEqual(program["pcr_pid"], self.generator.VideoPid(service))
+            self.assertGreater(program["bitrate"], 0)
+            pcr = program["pcr"]
+            self.assertEqual(pcr["pcrs"], 25)
+            self.assertEqual(pcr["discontinuities"], 0)
+            self.assertEqual(pcr["interval_errors"], 0)
+            self.assertLess(pcr["jitter_max_ns"], 1000)
+            self.assertAlmostEqual(pcr["bitrate"] / 20000000, 1.0, delta=0.01)
+        self.assertIn(self.generator.VideoPid(0), snapshot["pids"])
+
+    def test_sliding_window(self):
+        parser = libtssipython.Parser()
+        monitor = libtssipython.PcrMonitor(parser, window=1.0, slices=4)
+        self.assertIsNone(monitor.Snapshot()["clock"])
+        chunk = 188 * 1024
+        clock = 0
+        for offset in range(0, len(self.stream), chunk):
+            parser.Process(self.stream[offset:offset + chunk])
+            snapshot = monitor.Snapshot()
+            self.assertLessEqual(snapshot["slices"], 4)
+            self.assertAlmostEqual(snapshot["seconds"], snapshot["slices"] * 0.25, places=6)
+            if snapshot["clock"] is not None:
+                self.assertGreaterEqual(snapshot["clock"], clock)
+                clock = snapshot["clock"]
+        self.assertEqual(snapshot["slices"], 4)
+
+    def test_discontinuity(self):
+        generator = streams.generator(services=2, pcr_jump_ms=500, pcr_jump_at_ms=1000)
+        stream = generator.Generate(streams.packets(2.5))
+        parser = libtssipython.Parser()
+        monitor = libtssipython.PcrMonitor(parser, window=10.0, slices=40)
+        parser.Process(stream)
+        snapshot = monitor.Snapshot()
+        # the jump neither moves the clock nor ends up in a slice
+        self.assertEqual(snapshot["discarded"], 1)
+        self.assertAlmostEqual(snapshot["clock"], 2.46, delta=0.05)
+        self.assertAlmostEqual(snapshot["bitrate"] / 20000000, 1.0, delta=0.01)
+        for service in range(2):
+            pcr = snapshot["programs"][generator.ProgramNumber(service)]["pcr"]
+            self.assertEqual(pcr["discontinuities"], 1)
+            self.assertEqual(pcr["signalled_discontinuities"], 0)
+            self.assertLess(pcr["max_interval_ms"], 41)
+            self.assertAlmostEqual(pcr["bitrate"] / 20000000, 1.0, delta=0.01)
+
+    def test_unaligned(self):
+        parser = libtssipython.Parser()
+        monitor = libtssipython.PcrMonitor(parser, window=1.0, slices=4)
+        parser.Process(b"\x47\x00\x47" + self.stream)
+        snapshot = monitor.Snapshot()
+        self.assertEqual(snapshot["slices"], 4)
+        self.assertAlmostEqual(snapshot["bitrate"] / 20000000, 1.0, delta=0.01)
+        pcr = snapshot["programs"][self.generator.ProgramNumber(0)]["pcr"]
+        self.assertEqual(pcr["pcrs"], 25)
+        self.assertLess(pcr["jitter_max_ns"], 1000)
+
+    def test_pid_filter(self):
+        parser = libtssipython.Parser()
+        parser.SetPidFilter(deny=[0x1FFF])
+        self.assertRaises(RuntimeError, libtssipython.PcrMonitor, parser)
+
+        parser.SetPidFilter()
+        monitor = libtssipython.PcrMonitor(parser)
+        parser.SetPidFilter(allow=[0, 0x100])
+        self.assertRaises(RuntimeError, monitor.Snapshot)
+        parser.SetPidFilter()
+        self.assertEqual(monitor.Snapshot()["slices"], 0)
+
+    def test_reset(self):
+        parser = libtssipython.Parser()
+        monitor = libtssipython.PcrMonitor(parser, window=1.0, slices=4)
+        parser.Process(self.stream)
+        monitor.Reset()
+        snapshot = monitor.Snapshot()
+        self.assertEqual(snapshot["slices"], 0)
+        self.assertIsNone(snapshot["clock"])
+
+        # applied before the next buffer, the clock starts over
+        parser.Process(self.generator.Generate(streams.packets(1.5)))
+        snapshot = monitor.Snapshot()
+        self.assertEqual(snapshot["slices"], 4)
+        self.assertAlmostEqual(snapshot["clock"], 1.46, delta=0.05)
+
+
+if __name__ == "__main__":
+    unittest.main()
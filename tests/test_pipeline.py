@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Pipeline: reader and parser threads connected by a packet ring
+
+from __future__ import print_function
+
+import os
+import shutil
+import tempfile
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+
+class PipelineTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.stream = streams.generate(streams.packets(2.0), services=4)
+        cls.directory = tempfile.mkdtemp()
+        cls.path = os.path.join(cls.directory, "stream.ts")
+        with open(cls.path, "wb") as file:
+            file.write(cls.stream)
+
+    @classmethod
+    def tearDownClass(cls):
+        shutil.rmtree(cls.directory)
+
+    def test_file(self):
+        parser = libtssipython.Parser()
+        pipeline = libtssipython.Pipeline(parser, ring_packets=1024, block=True)
+        pipeline.StartFile(self.path)
+        self.assertTrue(pipeline.Wait(30.0))
+        self.assertFalse(pipeline.IsRunning())
+
+        statistics = pipeline.Statistics()
+        packets = len(self.stream) // 188
+        self.assertEqual(statistics["overruns"], 0)
+        self.assertEqual(statistics["packets_processed"], packets)
+        self.assertEqual(statistics["parser_packets_processed"], packets)
+        self.assertEqual(statistics["bytes_read"], len(self.stream))
+        self.assertLessEqual(statistics["ring_high_water"], 1024)
+
+        notifications = pipeline.Notifications()
+        for table in ("PAT", "PMT", "SDT", "EIT"):
+            self.assertIn(table, notifications)
+        self.assertEqual(pipeline.Notifications(), [])
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), 4)
+
+    def test_acquire_while_running(self):
+        read_end, write_end = os.pipe()
+        parser = libtssipython.Parser()
+        pipeline = libtssipython.Pipeline(parser, block=True)
+        pipeline.Start(read_end)
+
+        def write():
+            for offset in range(0, len(self.stream), 188 * 100):
+                os.write(write_end, self.stream[offset:offset + 188 * 100])
+            os.close(write_end)
+
+        writer = threading.Thread(target=write)
+        writer.start()
+        try:
+            # Statistics must not wait for the lock Python already holds
+            for _ in range(50):
+                with pipeline:
+                    parser.TableSdt().GetServiceListLength()
+                    statistics = pipeline.Statistics()
+                    self.assertEqual(statistics["parser_packets_processed"], parser.PacketsProcessed())
+                pipeline.Statistics()
+            self.assertRaises(RuntimeError, pipeline.Release)
+            with pipeline:
+                self.assertRaises(RuntimeError, pipeline.Acquire)
+        finally:
+            writer.join()
+            self.assertTrue(pipeline.Wait(30.0))
+            os.close(read_end)
+        self.assertEqual(pipeline.Statistics()["packets_processed"], len(self.stream) // 188)
+
+
+if __name__ == "__main__":
+    unittest.main()
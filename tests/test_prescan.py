@@ -0,0 +1,83 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    PID filter, 192/204 byte packets and resync in the prescan
+
+from __future__ import print_function
+
+import unittest
+
+import libtssipython
+import streams
+
+
+def resize(stream, size):
+    # M2TS puts a 4 byte timestamp first, 204 byte packets end in parity
+    out = bytearray()
+    for offset in range(0, len(stream), 188):
+        packet = stream[offset:offset + 188]
+        if size == 192:
+            out += b"\x00\x00\x00\x00" + packet
+        else:
+            out += packet + b"\x00" * 16
+    return bytes(out)
+
+
+class PrescanTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.generator = streams.generator(services=3)
+        cls.stream = cls.generator.Generate(streams.packets(1.0))
+        cls.packets = len(cls.stream) // 188
+        cls.plain = libtssipython.Parser()
+        cls.plain.Process(cls.stream)
+
+    def check_tables(self, parser):
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), self.plain.TableSdt().GetServiceListLength())
+        self.assertEqual(parser.TableEit().GetEventListLength(), self.plain.TableEit().GetEventListLength())
+        self.assertEqual(parser.TablePmt().GetProgramListLength(), 3)
+
+    def test_pid_filter(self):
+        allow = [0x00, 0x11, 0x12] + [self.generator.PmtPid(i) for i in range(3)]
+        wanted = sum(len(list(streams.packets_of(self.stream, pid))) for pid in allow)
+        parser = libtssipython.Parser()
+        parser.SetPidFilter(allow=allow)
+        parser.Process(self.stream)
+        self.check_tables(parser)
+        self.assertEqual(parser.PacketsProcessed(), wanted)
+        self.assertEqual(parser.Statistics()["filtered_packets"], self.packets - wanted)
+
+        parser = libtssipython.Parser()
+        parser.SetPidFilter(deny=[self.generator.VideoPid(i) for i in range(3)])
+        parser.Process(self.stream)
+        self.check_tables(parser)
+
+    def test_packet_sizes(self):
+        for size in (192, 204):
+            data = resize(self.stream, size)
+            for chunk in (len(data), 188 * 100 + 7, 1000):
+                parser = libtssipython.Parser()
+                parser.SetPacketSize(size)
+                for offset in range(0, len(data), chunk):
+                    self.assertTrue(parser.Process(data[offset:offset + chunk]))
+                self.assertEqual(parser.PacketsProcessed(), self.packets, (size, chunk))
+                self.assertEqual(parser.Statistics()["resyncs"], 0)
+                self.check_tables(parser)
+
+    def test_resync(self):
+        middle = self.packets // 2 * 188
+        data = self.stream[:middle] + b"\x00\x01\x02\x03\x04" + self.stream[middle:]
+        parser = libtssipython.Parser()
+        parser.SetPidFilter(deny=[])
+        parser.Process(data)
+        self.assertEqual(parser.PacketsProcessed(), self.packets)
+        self.assertEqual(parser.Statistics()["resyncs"], 1)
+        self.check_tables(parser)
+
+    def test_invalid_size(self):
+        self.assertRaises(ValueError, libtssipython.Parser().SetPacketSize, 190)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Parser.Process on buffers, iterables and files
+
+from __future__ import print_function
+
+import os
+import tempfile
+import unittest
+
+import libtssipython
+import streams
+
+
+class ProcessTest(unittest.TestCase):
+
+    def setUp(self):
+        self.stream = streams.generate(streams.packets(1.0), services=3)
+
+    def check_tables(self, parser):
+        pat = parser.TablePat()
+        self.assertEqual(pat.GetProgramListLength(), 3)
+        self.assertEqual(parser.TableSdt().GetServiceListLength(), 3)
+        self.assertGreater(parser.TableEit().GetEventListLength(), 0)
+
+    def test_buffer_types(self):
+        for wrap in (bytes, bytearray, memoryview):
+            parser = libtssipython.Parser()
+            self.assertTrue(parser.Process(wrap(self.stream)))
+            self.assertEqual(parser.PacketsProcessed(), len(self.stream) // 188)
+            self.check_tables(parser)
+
+    def test_iterable(self):
+        parser = libtssipython.Parser()
+        self.assertTrue(parser.Process(list(bytearray(self.stream))))
+        self.check_tables(parser)
+
+    def test_chunks(self):
+        # packets split at arbitrary offsets must parse like the whole buffer
+        parser = libtssipython.Parser()
+        for offset in range(0, len(self.stream), 188 * 7):
+            parser.Process(self.stream[offset:offset + 188 * 7])
+        self.check_tables(parser)
+
+    def test_file(self):
+        handle, path = tempfile.mkstemp(suffix=".ts")
+        try:
+            os.write(handle, self.stream)
+            os.close(handle)
+            parser = libtssipython.Parser()
+            self.assertEqual(parser.ProcessFile(path, chunk_size=188 * 100), (len(self.stream), 1))
+            self.check_tables(parser)
+        finally:
+            os.remove(path)
+
+
+if __name__ == "__main__":
+    unittest.main()
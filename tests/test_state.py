@@ -0,0 +1,111 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    RecordSections, SaveState and LoadState
+
+from __future__ import print_function
+
+import os
+import shutil
+import tempfile
+import unittest
+
+import libtssipython
+import streams
+
+
+class StateTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.mkdtemp()
+        self.path = os.path.join(self.directory, "parser.state")
+
+    def tearDown(self):
+        shutil.rmtree(self.directory)
+
+    def recorded(self, **fields):
+        parser = libtssipython.Parser()
+        parser.RecordSections(True)
+        parser.Process(streams.generate(streams.packets(1.2), **fields))
+        return parser
+
+    def check_same_tables(self, parser, restored):
+        self.assertEqual(restored.TablePat().GetProgramListLength(), parser.TablePat().GetProgramListLength())
+        self.assertEqual(restored.TablePmt().GetProgramListLength(), parser.TablePmt().GetProgramListLength())
+        self.assertEqual(restored.TableSdt().GetServiceListLength(), parser.TableSdt().GetServiceListLength())
+        self.assertEqual(restored.TableEit().GetEventListLength(), parser.TableEit().GetEventListLength())
+
+    def test_round_trip(self):
+        parser = self.recorded(services=3, events_per_service=12)
+        count = parser.SaveState(self.path)
+        self.assertGreater(count, 0)
+        self.assertFalse(os.path.exists(self.path + ".tmp"))
+
+        restored = libtssipython.Parser()
+        restored.RecordSections(True)
+        restored.QueueEvents(["SDT"])
+        self.assertEqual(restored.LoadState(self.path), count)
+        self.check_same_tables(parser, restored)
+        self.assertEqual(restored.TableEit().GetEventListLength(), 3 * 12)
+        self.assertIn("SDT", [event[0] for event in restored.PollEvents()])
+
+        # the restored parser records what it loaded
+        self.assertEqual(restored.SaveState(self.path), count)
+
+    def test_pmt_round_trip(self):
+        # PAT and PMTs arrive in one buffer on load; the PMTs must be
+        # recorded again, or a second snapshot loses them
+        generator = streams.generator(services=3)
+        parser = self.recorded(services=3)
+        parser.SaveState(self.path)
+
+        restored = libtssipython.Parser()
+        restored.RecordSections(True)
+        restored.LoadState(self.path)
+        second = os.path.join(self.directory, "second.state")
+        restored.SaveState(second)
+
+        again = libtssipython.Parser()
+        again.LoadState(second)
+        pmt = again.TablePmt()
+        self.assertEqual(pmt.GetProgramListLength(), 3)
+        for service in range(3):
+            self.assertEqual(pmt.GetPcrPid(generator.ProgramNumber(service)), generator.VideoPid(service))
+
+    def test_new_version_replaces_sections(self):
+        parser = self.recorded(services=2, events_per_service=12)
+        parser.Process(streams.generate(streams.packets(1.2), services=2, events_per_service=4, version=1))
+        parser.SaveState(self.path)
+
+        restored = libtssipython.Parser()
+        restored.LoadState(self.path)
+        self.assertEqual(restored.TableEit().GetEventListLength(), 2 * 4)
+        self.assertEqual(restored.TableSdt().GetServiceListLength(), 2)
+
+    def test_load_ignores_filter(self):
+        parser = self.recorded(services=2)
+        parser.SaveState(self.path)
+        restored = libtssipython.Parser()
+        restored.SetPidFilter(allow=[0x00])
+        restored.SetPacketSize(204)
+        restored.LoadState(self.path)
+        self.check_same_tables(parser, restored)
+
+    def test_errors(self):
+        self.assertRaises(RuntimeError, libtssipython.Parser().SaveState, self.path)
+        self.assertRaises(IOError, libtssipython.Parser().LoadState, os.path.join(self.directory, "missing"))
+
+        with open(self.path, "wb") as file:
+            file.write(b"not a parser state snapshot")
+        self.assertRaises(ValueError, libtssipython.Parser().LoadState, self.path)
+
+        self.recorded(services=2).SaveState(self.path)
+        with open(self.path, "rb") as file:
+            data = file.read()
+        with open(self.path, "wb") as file:
+            file.write(data[:len(data) // 2])
+        self.assertRaises(ValueError, libtssipython.Parser().LoadState, self.path)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    parser statistics: packet counts, continuity errors and kind times
+
+from __future__ import print_function
+
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+
+class StatisticsTest(unittest.TestCase):
+
+    def setUp(self):
+        self.stream = streams.generate(streams.packets(1.0), services=3)
+
+    def test_counts(self):
+        parser = libtssipython.Parser()
+        parser.EnableStatistics(True)
+        parser.Process(self.stream)
+        stats = parser.Statistics()
+        self.assertTrue(stats["enabled"])
+        self.assertEqual(stats["bytes"], len(self.stream))
+        self.assertEqual(stats["continuity_errors"], 0)
+        for pid in (0x00, 0x11, 0x12, 0x101):
+            self.assertEqual(stats["pids"][pid], (len(list(streams.packets_of(self.stream, pid))), 0))
+        self.assertGreater(stats["kind_seconds"]["EIT"], 0)
+        self.assertGreater(stats["kind_seconds"]["other"], 0)
+
+    def test_continuity_error(self):
+        eit = [offset for offset in range(0, len(self.stream), 188)
+               if bytearray(self.stream[offset + 1:offset + 3]) == bytearray([0x40, 0x12])
+               or bytearray(self.stream[offset + 1:offset + 3]) == bytearray([0x00, 0x12])]
+        dropped = eit[len(eit) // 2]
+        parser = libtssipython.Parser()
+        parser.EnableStatistics(True)
+        parser.Process(self.stream[:dropped] + self.stream[dropped + 188:])
+        stats = parser.Statistics()
+        self.assertEqual(stats["continuity_errors"], 1)
+        self.assertEqual(stats["pids"][0x12][1], 1)
+
+    def test_tables_unchanged(self):
+        # timed runs and attributed single packets parse like one call
+        plain = libtssipython.Parser()
+        plain.Process(self.stream)
+        for queue in (False, True):
+            parser = libtssipython.Parser()
+            parser.EnableStatistics(True)
+            if queue:
+                parser.QueueEvents(["PAT", "SDT", "EIT"])
+            parser.Process(self.stream)
+            self.assertEqual(parser.PacketsProcessed(), plain.PacketsProcessed())
+            self.assertEqual(parser.TableEit().GetEventListLength(), plain.TableEit().GetEventListLength())
+            self.assertEqual(parser.TableSdt().GetServiceListLength(), plain.TableSdt().GetServiceListLength())
+            if queue:
+                self.assertIn(0x12, [pid for source, pid, _, _, _ in parser.PollEvents() if source == "EIT"])
+
+    def test_moved_pid_loses_kind(self):
+        parser = libtssipython.Parser()
+        parser.EnableStatistics(True)
+        parser.SetPidEbu(0x404)
+        parser.Process(self.stream)
+        self.assertGreater(parser.Statistics()["kind_seconds"]["EBU"], 0)
+
+        parser.SetPidEbu(0x500)
+        parser.ResetStatistics()
+        parser.Process(self.stream)
+        self.assertEqual(parser.Statistics()["kind_seconds"]["EBU"], 0)
+
+    def test_reset_while_processing(self):
+        parser = libtssipython.Parser()
+        parser.EnableStatistics(True)
+        chunk = 188 * 512
+        done = threading.Event()
+
+        def process():
+            for offset in range(0, len(self.stream), chunk):
+                parser.Process(self.stream[offset:offset + chunk])
+            done.set()
+
+        worker = threading.Thread(target=process)
+        worker.start()
+        while not done.is_set():
+            parser.ResetStatistics()
+            parser.EnableStatistics(False)
+            parser.EnableStatistics(True)
+        worker.join()
+
+        parser.ResetStatistics()
+        parser.Process(self.stream)
+        stats = parser.Statistics()
+        self.assertEqual(stats["bytes"], len(self.stream))
+        self.assertEqual(sum(packets for packets, _ in stats["pids"].values()), len(self.stream) // 188)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    teletext page records: GetPageSnapshot and GetUpdatedPages
+
+from __future__ import print_function
+
+import threading
+import unittest
+
+import libtssipython
+import streams
+
+SIZE = libtssipython.TELETEXT_RECORD_SIZE
+
+
+def records(data):
+    data = bytearray(data)
+    return [data[offset:offset + SIZE] for offset in range(0, len(data), SIZE)]
+
+
+class TeletextTest(unittest.TestCase):
+
+    def setUp(self):
+        self.generator = streams.generator(services=1)
+        self.parser = libtssipython.Parser()
+        self.parser.SetPidEbu(0x404)
+        self.teletext = self.parser.PacketEbu()
+
+    def process(self, seconds):
+        self.parser.Process(self.generator.Generate(streams.packets(seconds)))
+
+    def test_updated_pages(self):
+        self.process(1.0)
+        updated = self.teletext.GetUpdatedPages()
+        self.assertEqual(len(updated) % SIZE, 0)
+        pages = records(updated)
+        self.assertTrue(pages)
+        for record in pages:
+            self.assertEqual(record[0], 1)
+            self.assertLess(record[1], 10)
+            row = bytes(record[8 + 40:8 + 80]).decode("ascii")
+            self.assertTrue(row.startswith("Row 01 of page 1%02x" % record[1]), row)
+
+        # nothing new without processing, every header changes with it
+        self.assertEqual(len(self.teletext.GetUpdatedPages()), 0)
+        self.process(1.0)
+        self.assertGreater(len(self.teletext.GetUpdatedPages()), 0)
+
+    def test_snapshot(self):
+        self.process(1.0)
+        for record in records(self.teletext.GetUpdatedPages()):
+            snapshot = self.teletext.GetPageSnapshot(record[0], record[1], record[2] | record[3] << 8)
+            self.assertEqual(bytearray(snapshot), record)
+        self.assertRaises(KeyError, self.teletext.GetPageSnapshot, 7, 0x99, 0)
+
+    def test_reset_reports_pages_again(self):
+        self.process(1.0)
+        self.teletext.GetUpdatedPages()
+        self.parser.Reset()
+        self.process(1.0)
+        self.assertGreater(len(self.teletext.GetUpdatedPages()), 0)
+
+    def test_while_processing(self):
+        stream = self.generator.Generate(streams.packets(2.0))
+        chunk = 188 * 128
+        done = threading.Event()
+
+        def process():
+            for offset in range(0, len(stream), chunk):
+                self.parser.Process(stream[offset:offset + chunk])
+            done.set()
+
+        worker = threading.Thread(target=process)
+        worker.start()
+        polled = 0
+        while not done.is_set():
+            updated = self.teletext.GetUpdatedPages()
+            self.assertEqual(len(updated) % SIZE, 0)
+            polled += len(updated)
+        worker.join()
+        polled += len(self.teletext.GetUpdatedPages())
+        self.assertGreater(polled, 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
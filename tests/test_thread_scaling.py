@@ -0,0 +1,102 @@
+#!/usr/bin/env python
+#
+#    libtssipython - Python wrapper for libtssi
+#    Parser.Process releasing the GIL for independent parsers on Python threads
+#
+#    Wall clock speed-ups depend on the machine, so the GIL release is
+#    checked directly: with an endless switch interval, another Python thread
+#    can only run while Process has given up the GIL.
+
+from __future__ import print_function
+
+import sys
+import threading
+import time
+import unittest
+
+import libtssipython
+import streams
+
+
+def run(buffer, threads, callback=None):
+    parsers = [libtssipython.Parser() for _ in range(threads)]
+    if callback is not None:
+        for parser in parsers:
+            parser.TableSdt().SetProcessCallback(callback)
+    workers = [threading.Thread(target=parser.Process, args=(buffer,))
+               for parser in parsers]
+    for worker in workers:
+        worker.start()
+    for worker in workers:
+        worker.join()
+    for parser in parsers:
+        assert parser.PacketsProcessed() == len(buffer) // 188
+
+
+class Counter(threading.Thread):
+
+    def __init__(self):
+        threading.Thread.__init__(self)
+        self.daemon = True
+        self.count = 0
+        self.running = threading.Event()
+        self.stopped = False
+
+    # sleep(0) hands the GIL back on every step
+    def run(self):
+        self.running.set()
+        while not self.stopped:
+            self.count += 1
+            time.sleep(0)
+
+
+class ThreadScalingTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.buffer = streams.generate(streams.packets(4.0), services=8, events_per_service=32)
+
+    def setUp(self):
+        # the main thread keeps the GIL unless it blocks or releases it
+        if hasattr(sys, "setswitchinterval"):
+            self.interval = sys.getswitchinterval()
+            sys.setswitchinterval(1000.0)
+        else:
+            self.interval = sys.getcheckinterval()
+            sys.setcheckinterval(1 << 30)
+
+    def tearDown(self):
+        if hasattr(sys, "setswitchinterval"):
+            sys.setswitchinterval(self.interval)
+        else:
+            sys.setcheckinterval(self.interval)
+
+    def test_gil_released(self):
+        counter = Counter()
+        counter.start()
+        counter.running.wait()
+
+        parser = libtssipython.Parser()
+        before = counter.count
+        parser.Process(self.buffer)
+        after = counter.count
+
+        counter.stopped = True
+        counter.join()
+        self.assertEqual(parser.PacketsProcessed(), len(self.buffer) // 188)
+        self.assertGreater(after, before)
+
+    def test_callbacks_from_threads(self):
+        calls = []
+        lock = threading.Lock()
+
+        def callback(*args):
+            with lock:
+                calls.append(threading.current_thread().name)
+
+        run(self.buffer, 2, callback)
+        self.assertGreaterEqual(len(set(calls)), 2)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,133 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+// Test runner: runs one Python test script with the libtssipython module
+// and the synthetic stream generator (module tsgen) compiled in.
+//
+//   tssitest tests/test_process.py [arguments]
+//
+// The exit status is the one of the script, unittest.main() sets it.
+
+#include <boost/python.hpp>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../bench/ts_generator.h"
+
+using namespace boost::python;
+
+#if PY_MAJOR_VERSION >= 3
+extern "C" PyObject* PyInit_libtssipython();
+#else
+extern "C" void initlibtssipython();
+#endif
+
+namespace {
+
+// StreamGenerator.Generate(packets) as bytes (str on Python 2)
+object Generate(tssibench::StreamGenerator& self, std::size_t packets) {
+	std::vector<unsigned char> stream;
+	self.Generate(stream, packets);
+	return object(handle<>(PyBytes_FromStringAndSize(stream.empty() ? "" : reinterpret_cast<const char*>(&stream[0]), static_cast<Py_ssize_t>(stream.size()))));
+}
+
+}
+
+BOOST_PYTHON_MODULE(tsgen)
+{
+	class_<tssibench::GeneratorConfig>("GeneratorConfig")
+		.def_readwrite("services", &tssibench::GeneratorConfig::services)
+		.def_readwrite("events_per_service", &tssibench::GeneratorConfig::events_per_service)
+		.def_readwrite("bitrate", &tssibench::GeneratorConfig::bitrate)
+		.def_readwrite("teletext_pid", &tssibench::GeneratorConfig::teletext_pid)
+		.def_readwrite("pcr_interval_ms", &tssibench::GeneratorConfig::pcr_interval_ms)
+		.def_readwrite("pcr_jump_ms", &tssibench::GeneratorConfig::pcr_jump_ms)
+		.def_readwrite("pcr_jump_at_ms", &tssibench::GeneratorConfig::pcr_jump_at_ms)
+		.def_readwrite("psi_interval_ms", &tssibench::GeneratorConfig::psi_interval_ms)
+		.def_readwrite("si_interval_ms", &tssibench::GeneratorConfig::si_interval_ms)
+		.def_readwrite("tdt_interval_ms", &tssibench::GeneratorConfig::tdt_interval_ms)
+		.def_readwrite("teletext_interval_ms", &tssibench::GeneratorConfig::teletext_interval_ms)
+		.def_readwrite("transport_stream_id", &tssibench::GeneratorConfig::transport_stream_id)
+		.def_readwrite("original_network_id", &tssibench::GeneratorConfig::original_network_id)
+		.def_readwrite("pack_sections", &tssibench::GeneratorConfig::pack_sections)
+		.def_readwrite("schedule_present", &tssibench::GeneratorConfig::schedule_present)
+		.def_readwrite("version", &tssibench::GeneratorConfig::version)
+	;
+
+	class_<tssibench::StreamGenerator, boost::noncopyable>("StreamGenerator", init<const tssibench::GeneratorConfig&>())
+		.def("Generate", &Generate)
+		.def("ProgramNumber", &tssibench::StreamGenerator::ProgramNumber)
+		.def("PmtPid", &tssibench::StreamGenerator::PmtPid)
+		.def("VideoPid", &tssibench::StreamGenerator::VideoPid)
+		.def("AudioPid", &tssibench::StreamGenerator::AudioPid)
+	;
+}
+
+#if PY_MAJOR_VERSION >= 3
+extern "C" PyObject* PyInit_tsgen();
+#else
+extern "C" void inittsgen();
+#endif
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: tssitest SCRIPT [ARGUMENTS]\n");
+		return 2;
+	}
+
+	std::FILE* script = std::fopen(argv[1], "r");
+	if (!script) {
+		std::perror(argv[1]);
+		return 2;
+	}
+
+#if PY_MAJOR_VERSION >= 3
+	PyImport_AppendInittab("libtssipython", &PyInit_libtssipython);
+	PyImport_AppendInittab("tsgen", &PyInit_tsgen);
+#else
+	PyImport_AppendInittab(const_cast<char*>("libtssipython"), &initlibtssipython);
+	PyImport_AppendInittab(const_cast<char*>("tsgen"), &inittsgen);
+#endif
+	Py_Initialize();
+
+	// sys.argv as for "python SCRIPT ARGUMENTS", the script directory first
+	// on sys.path for shared test helpers
+	try {
+		const std::string path = argv[1];
+		const std::string::size_type slash = path.find_last_of("/\\");
+		object sys = import("sys");
+		list arguments;
+		for (int i = 1; i < argc; ++i)
+			arguments.append(str(static_cast<const char*>(argv[i])));
+		sys.attr("argv") = arguments;
+		sys.attr("path").attr("insert")(0, str(slash == std::string::npos ? std::string(".") : path.substr(0, slash)));
+	}
+	catch (const error_already_set&) {
+		PyErr_Print();
+		return 1;
+	}
+
+	// SystemExit raised by the script ends the process with its status
+	const int status = PyRun_SimpleFileEx(script, argv[1], 1);
+	return status == 0 ? 0 : 1;
+}
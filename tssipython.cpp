@@ -19,37 +19,18 @@
 *
 --*/
 
-#ifndef __TSSIPYTHON_H_INCLUDED__
-#define __TSSIPYTHON_H_INCLUDED__
-
-#include <boost/python.hpp>
-#include <boost/python/module.hpp>
-#include <boost/python/stl_iterator.hpp> 
-#include <vector>
-
-using namespace boost::python;
-
-#include "tssi.h"
-
-// python buffer wrapper
-static TS_BOOL ParserProcessPython(tssi::Parser& self, object py_buffer) {
-	// from http://stackoverflow.com/questions/32634765/how-do-i-pass-a-pre-populated-unsigned-char-buffer-to-a-c-method-using-boos
-
-	// `str` objects do not implement the iterator protcol (__iter__),
-	// but do implement the sequence protocol (__getitem__).  Use the
-	// `iter()` builtin to create an iterator for the buffer.
-	// >>> __builtins__.iter(py_buffer)
-	object locals(borrowed(PyEval_GetLocals()));
-	object py_iter = locals["__builtins__"].attr("iter");
-	stl_input_iterator<unsigned char> begin(py_iter(py_buffer)), end;
-
-	// Copy the py_buffer into a local buffer with known continguous memory.
-	std::vector<unsigned char> buffer(begin, end);
-
-	// Cast and delegate to the printBuffer member function.
-	return self.Process(reinterpret_cast<unsigned char*>(&buffer[0]), static_cast<unsigned> ( buffer.size() ));
-
-}
+#include "tssipython.h"
+#include "tssipython_batch.h"
+#include "tssipython_changes.h"
+#include "tssipython_columns.h"
+#include "tssipython_dsmcc.h"
+#include "tssipython_index.h"
+#include "tssipython_ingest.h"
+#include "tssipython_parser.h"
+#include "tssipython_pcr.h"
+#include "tssipython_pipeline.h"
+#include "tssipython_state.h"
+#include "tssipython_teletext.h"
 
 // wrapping overloaded functions
 const tssi::EbuPage& (tssi::Packet_Ebu::*GetEbuPage1) (unsigned) const = &tssi::Packet_Ebu::GetEbuPage;
@@ -61,24 +42,13 @@ unsigned (tssi::DescriptorList::*GetDescriptorListLength2) (TS_BYTE) const = &ts
 tssi::Descriptor* (tssi::DescriptorList::*GetDescriptorByTag1) (TS_BYTE) const = &tssi::DescriptorList::GetDescriptorByTag;
 tssi::Descriptor* (tssi::DescriptorList::*GetDescriptorByTag2) (TS_BYTE, unsigned) const = &tssi::DescriptorList::GetDescriptorByTag;
 
-// callback wrappers
-TS_VOID PythonCallback(TS_PVOID data) {
-	PyObject *callback = reinterpret_cast<PyObject *> (data);
-
-	PyEval_InitThreads();
-	PyGILState_STATE state = PyGILState_Ensure();
-
-	call<void>(callback);
-
-	PyGILState_Release(state);
-}
-
-TS_VOID SetEbuCallback(tssi::Packet_Ebu& self, object py_callback) {	self.SetNewPageCallback(&PythonCallback, &py_callback); }
-TS_VOID SetPcrCallback(tssi::Packet_Pcr& self, object py_callback) {	self.SetPcrCallback(&PythonCallback, &py_callback); }
-template<class T> TS_VOID SetTableCallback(T& self, object py_callback) { self.SetProcessCallback(&PythonCallback, &py_callback); }
-
 BOOST_PYTHON_MODULE(libtssipython)
 {
+	// Process releases the GIL, callbacks need a thread state to return to
+#if PY_VERSION_HEX < 0x03070000
+	PyEval_InitThreads();
+#endif
+
 	class_<tssi::Descriptor, boost::noncopyable>("Descriptor")
 		.def("Reset", &tssi::Descriptor::Reset)
 		.def("GetDescriptorTag", &tssi::Descriptor::GetDescriptorTag)
@@ -281,7 +251,10 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("GetEbuPage", GetEbuPage2, return_internal_reference<>())
 		.def("GetCurrentTimeHeader", &tssi::Packet_Ebu::GetCurrentTimeHeader)
 		.def("SetNewPageCallback", &SetEbuCallback)
+		.def("GetPageSnapshot", &EbuPageSnapshot)
+		.def("GetUpdatedPages", &EbuUpdatedPages)
 	;
+	scope().attr("TELETEXT_RECORD_SIZE") = TELETEXT_RECORD_SIZE;
 
 	class_<tssi::Packet_Pcr, boost::noncopyable>("Packet_Pcr")
 		.def("Reset", &tssi::Packet_Pcr::Reset)	
@@ -318,6 +291,9 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("Reset", &tssi::Table_Eit::Reset)	
 		.def("GetEventListLength", &tssi::Table_Eit::GetEventListLength)	
 		.def("GetEvent", &tssi::Table_Eit::GetEvent, return_internal_reference<>())	
+		.def("GetEventColumns", &EitEventColumns)	
+		.def("FindEvent", &EitFindEvent, (arg("self"), arg("service_id"), arg("event_id"), arg("original_network_id") = object(), arg("transport_stream_id") = object()))
+		.def("FindEvents", &EitFindEvents, (arg("self"), arg("service_id"), arg("start") = object(), arg("end") = object(), arg("original_network_id") = object(), arg("transport_stream_id") = object()))
 		.def("SetProcessCallback", &SetTableCallback<tssi::Table_Eit>, return_internal_reference<>())	
 	;
 
@@ -369,6 +345,7 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("Reset", &tssi::Table_Sdt::Reset)
 		.def("GetServiceListLength", &tssi::Table_Sdt::GetServiceListLength)
 		.def("GetServiceDescription", &tssi::Table_Sdt::GetServiceDescription, return_internal_reference<>())
+		.def("FindService", &SdtFindService, (arg("self"), arg("service_id"), arg("original_network_id") = object(), arg("transport_stream_id") = object()))
 		.def("SetProcessCallback", &SetTableCallback<tssi::Table_Sdt>, return_internal_reference<>())	
 	;
 
@@ -376,8 +353,8 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("Reset", &tssi::Table_Dsmcc::Reset)
 		.def("GetDownloadListLength", &tssi::Table_Dsmcc::GetDownloadListLength)
 		.def("IsDownloadComplete", &tssi::Table_Dsmcc::IsDownloadComplete)
-		.def("ProcessDownload", &tssi::Table_Dsmcc::ProcessDownload)
-		.def("Decode", &tssi::Table_Dsmcc::Decode)
+		.def("ProcessDownload", &DsmccProcessDownload)
+		.def("Decode", &DsmccDecode)
 	;
 
 	class_<TS_TIME>("TS_TIME")
@@ -397,13 +374,26 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("SetProcessCallback", &SetTableCallback<tssi::Table_Tdt>, return_internal_reference<>())	
 	;
 
-	class_<tssi::Parser, boost::noncopyable>("Parser")
-		.def("Reset", &tssi::Parser::Reset)	
+	class_<PythonParser, boost::noncopyable>("Parser")
+		.def("Reset", &PythonParser::Reset)	
 		.def("Process", &ParserProcessPython, (arg("self"), arg("py_buffer")))
-		.def("SetPidDsmcc", &tssi::Parser::SetPidDsmcc)	
-		.def("SetPidAit", &tssi::Parser::SetPidAit)	
-		.def("SetPidPcr", &tssi::Parser::SetPidPcr)	
-		.def("SetPidEbu", &tssi::Parser::SetPidEbu)	
+		.def("ProcessFile", &ParserProcessFile, (arg("self"), arg("path"), arg("chunk_size") = DEFAULT_CHUNK_SIZE, arg("offset") = 0, arg("length") = -1))
+		.def("ProcessFd", &ParserProcessFd, (arg("self"), arg("fd"), arg("chunk_size") = DEFAULT_CHUNK_SIZE, arg("length") = -1))
+		.def("SetPidDsmcc", &PythonParser::SetPidDsmcc)	
+		.def("SetPidAit", &PythonParser::SetPidAit)	
+		.def("SetPidPcr", &PythonParser::SetPidPcr)	
+		.def("SetPidFilter", &PythonParser::SetPidFilter, (arg("self"), arg("allow") = object(), arg("deny") = object()))
+		.def("SetPacketSize", &PythonParser::SetPacketSize)
+		.def("RecordSections", &PythonParser::RecordSections)
+		.def("SaveState", &ParserSaveState)
+		.def("LoadState", &ParserLoadState)
+		.def("SetPidEbu", &ParserSetPidEbu, (arg("self"), arg("pid"), arg("subtitles_only") = false, arg("pages") = object()))	
+		.def("QueueEvents", &PythonParser::QueueEvents)	
+		.def("PollEvents", &PythonParser::PollEvents)	
+		.def("SetEventCallback", &PythonParser::SetEventCallback)	
+		.def("EnableStatistics", &PythonParser::EnableStatistics)	
+		.def("ResetStatistics", &PythonParser::ResetStatistics)	
+		.def("Statistics", &PythonParser::Statistics)	
 		.def("ProcessingErrors", &tssi::Parser::ProcessingErrors)	
 		.def("PacketsProcessed", &tssi::Parser::PacketsProcessed)	
 		.def("PacketEbu", &tssi::Parser::PacketEbu, return_internal_reference<>())
@@ -418,6 +408,37 @@ BOOST_PYTHON_MODULE(libtssipython)
 		.def("TableTdt", &tssi::Parser::TableTdt, return_internal_reference<>())
 	;
 
-}
+	class_<CapturePipeline, boost::noncopyable>("Pipeline", init<object, unsigned, bool>((arg("parser"), arg("ring_packets") = 65536, arg("block") = false)))
+		.def("Start", &CapturePipeline::Start)
+		.def("StartFile", &CapturePipeline::StartFile)
+		.def("Stop", &CapturePipeline::Stop)
+		.def("Wait", &CapturePipeline::Wait, (arg("self"), arg("timeout") = -1.0))
+		.def("IsRunning", &CapturePipeline::IsRunning)
+		.def("Statistics", &CapturePipeline::Statistics)
+		.def("Notifications", &CapturePipeline::Notifications)
+		.def("Acquire", &CapturePipeline::Acquire)
+		.def("Release", &CapturePipeline::Release)
+		.def("__enter__", &CapturePipeline::Enter)
+		.def("__exit__", &CapturePipeline::Exit)
+	;
+
+	class_<ChangeTracker, boost::noncopyable>("ChangeTracker", init<object>((arg("parser"))))
+		.def("Generation", &ChangeTracker::Generation)
+		.def("GetChanges", &ChangeTracker::GetChanges, (arg("self"), arg("table"), arg("since") = 0))
+	;
+
+	class_<DsmccDecoder, boost::noncopyable>("DsmccDecoder", init<object, object, object, std::size_t>((arg("parser"), arg("pids"), arg("output") = object(), arg("queue_packets") = 65536)))
+		.def("PollCompleted", &DsmccDecoder::PollCompleted)
+		.def("Dropped", &DsmccDecoder::Dropped)
+		.def("Wait", &DsmccDecoder::Wait, (arg("self"), arg("timeout") = -1.0))
+		.def("Stop", &DsmccDecoder::Stop)
+	;
 
-#endif // __TSSIPYTHON_H_INCLUDED__
\ No newline at end of file
+	class_<PcrMonitor, boost::noncopyable>("PcrMonitor", init<object, double, unsigned>((arg("parser"), arg("window") = 1.0, arg("slices") = 10)))
+		.def("Snapshot", &PcrMonitor::Snapshot)
+		.def("Reset", &PcrMonitor::Reset)
+	;
+
+	def("process_files", &ProcessFiles, (arg("paths"), arg("threads") = 0, arg("pids") = object(), arg("chunk_size") = DEFAULT_CHUNK_SIZE));
+
+}
@@ -0,0 +1,174 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+// declarations shared by all translation units of the module
+
+#ifndef __TSSIPYTHON_COMMON_H_INCLUDED__
+#define __TSSIPYTHON_COMMON_H_INCLUDED__
+
+#include <boost/python.hpp>
+#include <boost/python/module.hpp>
+#include <boost/python/stl_iterator.hpp> 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace boost::python;
+
+#include "tssi.h"
+
+// releases the GIL for the lifetime of the object; native code running
+// in this scope must not touch Python objects
+class ScopedGILRelease : boost::noncopyable {
+public:
+	ScopedGILRelease() : state_(PyEval_SaveThread()) {}
+	~ScopedGILRelease() { PyEval_RestoreThread(state_); }
+
+private:
+	PyThreadState* state_;
+};
+
+typedef std::atomic<unsigned long long> Counter;
+
+inline void Bump(Counter& counter, unsigned long long value) {
+	counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline unsigned long long Nanoseconds(std::chrono::steady_clock::time_point start) {
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+// FNV-1a over the fields of a table entry or teletext page
+class Fingerprint {
+public:
+	Fingerprint() : hash_(14695981039346656037ULL) {}
+
+	Fingerprint& Add(unsigned long long value) {
+		for (int i = 0; i < 8; ++i, value >>= 8)
+			Byte(static_cast<unsigned char>(value));
+		return *this;
+	}
+
+	Fingerprint& Add(const std::string& value) {
+		Add(value.size());
+		for (std::size_t i = 0; i < value.size(); ++i)
+			Byte(static_cast<unsigned char>(value[i]));
+		return *this;
+	}
+
+	Fingerprint& Add(const unsigned char* data, std::size_t length) {
+		for (std::size_t i = 0; i < length; ++i)
+			Byte(data[i]);
+		return *this;
+	}
+
+	unsigned long long Value() const { return hash_; }
+
+private:
+	void Byte(unsigned char value) {
+		hash_ = (hash_ ^ value) * 1099511628211ULL;
+	}
+
+	unsigned long long hash_;
+};
+
+// file and descriptor helpers
+
+static const std::size_t DEFAULT_CHUNK_SIZE = 188 * 4096 * 4;
+
+#ifdef _WIN32
+#define TSSIPY_OPEN_FLAGS (_O_RDONLY | _O_BINARY)
+#define TSSIPY_READ(fd, buf, len) _read(fd, buf, static_cast<unsigned>(len))
+#define TSSIPY_SEEK(fd, pos) _lseeki64(fd, pos, SEEK_SET)
+#define TSSIPY_TELL(fd) _telli64(fd)
+#define TSSIPY_CLOSE _close
+#define TSSIPY_OPEN _open
+#define TSSIPY_MKDIR(path) _mkdir(path)
+#else
+#define TSSIPY_OPEN_FLAGS O_RDONLY
+#define TSSIPY_READ(fd, buf, len) read(fd, buf, len)
+#define TSSIPY_SEEK(fd, pos) lseek(fd, static_cast<off_t>(pos), SEEK_SET)
+#define TSSIPY_TELL(fd) static_cast<long long>(lseek(fd, 0, SEEK_CUR))
+#define TSSIPY_CLOSE close
+#define TSSIPY_OPEN open
+#define TSSIPY_MKDIR(path) mkdir(path, 0777)
+#endif
+
+class FileDescriptor : boost::noncopyable {
+public:
+	explicit FileDescriptor(int fd) : fd_(fd) {}
+	~FileDescriptor() { if (fd_ >= 0) TSSIPY_CLOSE(fd_); }
+	int get() const { return fd_; }
+
+private:
+	int fd_;
+};
+
+inline void RaiseIOError(const std::string& name) {
+	PyErr_SetFromErrnoWithFilename(PyExc_IOError, const_cast<char*>(name.c_str()));
+	throw_error_already_set();
+}
+
+// lets Ctrl-C interrupt long running ingest between chunks
+inline void CheckSignals() {
+	if (PyErr_CheckSignals() != 0)
+		throw_error_already_set();
+}
+
+inline std::size_t PacketAlignedChunk(std::size_t chunk_size) {
+	return chunk_size < 188 ? 188 : chunk_size / 188 * 188;
+}
+
+// bytes (str on Python 2) holding a copy of data
+inline object BytesObject(const std::string& data) {
+	return object(handle<>(PyBytes_FromStringAndSize(data.data(), static_cast<Py_ssize_t>(data.size()))));
+}
+
+#endif // __TSSIPYTHON_COMMON_H_INCLUDED__
@@ -0,0 +1,313 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_batch.h"
+
+// parallel batch processing
+//
+// One plain tssi::Parser per file on a pool of native threads. Files are
+// dealt largest first to per-worker queues; idle workers steal from the
+// back of the others, so a few huge recordings do not leave threads idle.
+
+static const long long MAX_BATCH_THREADS = 1024;
+
+struct BatchPids {
+	int dsmcc;
+	int ait;
+	int pcr;
+	int ebu;
+};
+
+struct FileSummary {
+	struct Program {
+		unsigned number;
+		unsigned pcr_pid;
+		std::vector<std::pair<unsigned, unsigned> > streams;   // type, pid
+	};
+
+	struct Service {
+		unsigned original_network_id;
+		unsigned transport_stream_id;
+		unsigned service_id;
+		std::string provider;
+		std::string name;
+	};
+
+	std::string path;
+	unsigned long long size;
+	int error;                                                 // errno, formatted by the calling thread
+	unsigned long long bytes;
+	unsigned long long packets_processed;
+	unsigned long long processing_errors;
+	unsigned transport_stream_id;
+	unsigned network_pid;
+	std::vector<std::pair<unsigned, unsigned> > programs;      // number, PMT pid
+	std::vector<Program> pmt;
+	std::vector<Service> sdt;
+	unsigned eit_events;
+	std::map<unsigned, unsigned> eit_services;                 // service id, events
+};
+
+// reads path into parser in chunks, no Python involved; returns false and
+// sets error to errno on failure
+static bool FeedFile(tssi::Parser& parser, const std::string& path, std::size_t chunk_size, unsigned long long& bytes, int& error) {
+	FileDescriptor file(TSSIPY_OPEN(path.c_str(), TSSIPY_OPEN_FLAGS));
+	if (file.get() < 0) {
+		error = errno;
+		return false;
+	}
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+	posix_fadvise(file.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	chunk_size = PacketAlignedChunk(chunk_size);
+	std::vector<unsigned char> buffer(chunk_size);
+	std::size_t filled = 0;
+	for (;;) {
+		const Py_ssize_t got = TSSIPY_READ(file.get(), &buffer[filled], chunk_size - filled);
+		if (got < 0) {
+			if (errno == EINTR)
+				continue;
+			error = errno;
+			return false;
+		}
+		filled += static_cast<std::size_t>(got);
+		if (got > 0 && filled < chunk_size)
+			continue;
+		if (filled > 0)
+			parser.Process(&buffer[0], static_cast<unsigned>(filled));
+		bytes += filled;
+		filled = 0;
+		if (got == 0)
+			return true;
+	}
+}
+
+static void SummarizeFile(tssi::Parser& parser, FileSummary& summary) {
+	summary.packets_processed = parser.PacketsProcessed();
+	summary.processing_errors = parser.ProcessingErrors();
+
+	tssi::Table_Pat& pat = parser.TablePat();
+	summary.transport_stream_id = pat.GetTransportStreamId();
+	summary.network_pid = pat.GetNetworkPid();
+	for (unsigned i = 0; i < pat.GetProgramListLength(); ++i)
+		summary.programs.push_back(std::pair<unsigned, unsigned>(pat.GetProgramNumber(i), pat.GetProgramMapPid(i)));
+
+	tssi::Table_Pmt& pmt = parser.TablePmt();
+	for (unsigned i = 0; i < pmt.GetProgramListLength(); ++i) {
+		FileSummary::Program program;
+		program.number = pmt.GetProgramNumber(i);
+		program.pcr_pid = pmt.GetPcrPid(program.number);
+		for (unsigned j = 0; j < pmt.GetEsListLength(program.number); ++j)
+			program.streams.push_back(std::pair<unsigned, unsigned>(pmt.GetEsType(program.number, j), pmt.GetEsPid(program.number, j)));
+		summary.pmt.push_back(program);
+	}
+
+	tssi::Table_Sdt& sdt = parser.TableSdt();
+	for (unsigned i = 0; i < sdt.GetServiceListLength(); ++i) {
+		const tssi::ServiceDescription& description = sdt.GetServiceDescription(i);
+		FileSummary::Service service;
+		service.original_network_id = description.original_network_id;
+		service.transport_stream_id = description.transport_stream_id;
+		service.service_id = description.service_id;
+		const tssi::Descriptor_Service* descriptor = dynamic_cast<const tssi::Descriptor_Service*>(description.descriptor_list.GetDescriptorByTag(0x48));
+		if (descriptor) {
+			service.provider = descriptor->GetProviderName();
+			service.name = descriptor->GetServiceName();
+		}
+		summary.sdt.push_back(service);
+	}
+
+	tssi::Table_Eit& eit = parser.TableEit();
+	summary.eit_events = eit.GetEventListLength();
+	for (unsigned i = 0; i < summary.eit_events; ++i)
+		++summary.eit_services[eit.GetEvent(i).service_id];
+}
+
+static void ProcessBatchFile(FileSummary& summary, const BatchPids& pids, std::size_t chunk_size) {
+	std::unique_ptr<tssi::Parser> parser(new tssi::Parser());
+	if (pids.dsmcc >= 0)
+		parser->SetPidDsmcc(static_cast<TS_WORD>(pids.dsmcc));
+	if (pids.ait >= 0)
+		parser->SetPidAit(static_cast<TS_WORD>(pids.ait));
+	if (pids.pcr >= 0)
+		parser->SetPidPcr(static_cast<TS_WORD>(pids.pcr));
+	if (pids.ebu >= 0)
+		parser->SetPidEbu(static_cast<TS_WORD>(pids.ebu));
+
+	if (FeedFile(*parser, summary.path, chunk_size, summary.bytes, summary.error))
+		SummarizeFile(*parser, summary);
+}
+
+class WorkStealingPool : boost::noncopyable {
+public:
+	WorkStealingPool(std::vector<FileSummary>& files, unsigned threads) : files_(files), queues_(threads) {
+		std::vector<std::size_t> order(files.size());
+		for (std::size_t i = 0; i < order.size(); ++i)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&files](std::size_t a, std::size_t b) { return files[a].size > files[b].size; });
+		for (std::size_t i = 0; i < order.size(); ++i)
+			queues_[i % threads].tasks.push_back(order[i]);
+	}
+
+	template<class F> void Run(F work) {
+		std::vector<std::thread> workers;
+		for (std::size_t i = 0; i < queues_.size(); ++i)
+			workers.push_back(std::thread([this, i, &work]() {
+				std::size_t task;
+				while (Next(i, task))
+					work(files_[task]);
+			}));
+		for (std::size_t i = 0; i < workers.size(); ++i)
+			workers[i].join();
+	}
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::size_t> tasks;
+	};
+
+	// own work from the front, stolen work from the back of the others
+	bool Next(std::size_t worker, std::size_t& task) {
+		for (std::size_t i = 0; i < queues_.size(); ++i) {
+			Queue& queue = queues_[(worker + i) % queues_.size()];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+			if (i == 0) {
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else {
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<FileSummary>& files_;
+	std::vector<Queue> queues_;
+};
+
+static int BatchPid(dict pids, const char* name) {
+	object value = pids.get(name);
+	return value.is_none() ? -1 : extract<int>(value);
+}
+
+static dict FileSummaryDict(const FileSummary& summary) {
+	dict result;
+	result["path"] = summary.path;
+	// strerror is not thread-safe, so the workers only keep errno
+	result["error"] = summary.error ? object(std::string(std::strerror(summary.error))) : object();
+	result["bytes"] = summary.bytes;
+	result["packets_processed"] = summary.packets_processed;
+	result["processing_errors"] = summary.processing_errors;
+
+	dict pat;
+	list programs;
+	for (std::size_t i = 0; i < summary.programs.size(); ++i)
+		programs.append(make_tuple(summary.programs[i].first, summary.programs[i].second));
+	pat["transport_stream_id"] = summary.transport_stream_id;
+	pat["network_pid"] = summary.network_pid;
+	pat["programs"] = programs;
+	result["pat"] = pat;
+
+	list pmt;
+	for (std::size_t i = 0; i < summary.pmt.size(); ++i) {
+		const FileSummary::Program& program = summary.pmt[i];
+		list streams;
+		for (std::size_t j = 0; j < program.streams.size(); ++j)
+			streams.append(make_tuple(program.streams[j].first, program.streams[j].second));
+		dict entry;
+		entry["program_number"] = program.number;
+		entry["pcr_pid"] = program.pcr_pid;
+		entry["streams"] = streams;
+		pmt.append(entry);
+	}
+	result["pmt"] = pmt;
+
+	list sdt;
+	for (std::size_t i = 0; i < summary.sdt.size(); ++i) {
+		const FileSummary::Service& service = summary.sdt[i];
+		dict entry;
+		entry["original_network_id"] = service.original_network_id;
+		entry["transport_stream_id"] = service.transport_stream_id;
+		entry["service_id"] = service.service_id;
+		entry["provider_name"] = service.provider;
+		entry["service_name"] = service.name;
+		sdt.append(entry);
+	}
+	result["sdt"] = sdt;
+
+	dict eit, services;
+	for (std::map<unsigned, unsigned>::const_iterator it = summary.eit_services.begin(); it != summary.eit_services.end(); ++it)
+		services[it->first] = it->second;
+	eit["events"] = summary.eit_events;
+	eit["services"] = services;
+	result["eit"] = eit;
+	return result;
+}
+
+list ProcessFiles(object paths, long long threads, object py_pids, std::size_t chunk_size) {
+	if (threads < 0 || threads > MAX_BATCH_THREADS) {
+		PyErr_SetString(PyExc_ValueError, "threads must be between 0 (one per core) and 1024");
+		throw_error_already_set();
+	}
+
+	BatchPids pids = { -1, -1, -1, -1 };
+	if (!py_pids.is_none()) {
+		dict pid_dict(py_pids);
+		pids.dsmcc = BatchPid(pid_dict, "dsmcc");
+		pids.ait = BatchPid(pid_dict, "ait");
+		pids.pcr = BatchPid(pid_dict, "pcr");
+		pids.ebu = BatchPid(pid_dict, "ebu");
+	}
+
+	std::vector<FileSummary> files;
+	stl_input_iterator<std::string> begin(paths), end;
+	for (; begin != end; ++begin) {
+		FileSummary summary = FileSummary();
+		summary.path = *begin;
+		files.push_back(summary);
+	}
+
+	std::size_t workers = threads ? static_cast<std::size_t>(threads) : std::max(1u, std::thread::hardware_concurrency());
+	if (workers > files.size())
+		workers = std::max<std::size_t>(1, files.size());
+
+	{
+		ScopedGILRelease nogil;
+		for (std::size_t i = 0; i < files.size(); ++i) {
+			struct stat info;
+			files[i].size = stat(files[i].path.c_str(), &info) == 0 ? static_cast<unsigned long long>(info.st_size) : 0;
+		}
+		WorkStealingPool pool(files, static_cast<unsigned>(workers));
+		pool.Run([&pids, chunk_size](FileSummary& summary) { ProcessBatchFile(summary, pids, chunk_size); });
+	}
+
+	list result;
+	for (std::size_t i = 0; i < files.size(); ++i)
+		result.append(FileSummaryDict(files[i]));
+	return result;
+}
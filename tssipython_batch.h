@@ -0,0 +1,32 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_BATCH_H_INCLUDED__
+#define __TSSIPYTHON_BATCH_H_INCLUDED__
+
+#include "tssipython.h"
+
+// process_files(paths, threads=0, pids=None, chunk_size=...): threads 0 uses
+// all cores, more than 1024 raise ValueError; pids may set "dsmcc", "ait",
+// "pcr" and "ebu"
+list ProcessFiles(object paths, long long threads, object py_pids, std::size_t chunk_size);
+
+#endif // __TSSIPYTHON_BATCH_H_INCLUDED__
@@ -0,0 +1,404 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_CHANGES_H_INCLUDED__
+#define __TSSIPYTHON_CHANGES_H_INCLUDED__
+
+#include "tssipython_parser.h"
+
+// section driven change tracking
+//
+// The tracker sees every section of the SDT, EIT, NIT and PMT as the
+// parser assembles it. A section whose CRC did not change is skipped;
+// otherwise its entries are fingerprinted from the raw section bytes and
+// compared with what the section held before. Every section that changes
+// entries advances the table's generation and appends the changed keys to
+// a change log, so Python only gets the entries added, updated or removed
+// since a given generation, without walking the tables.
+
+enum TrackedTable { TRACK_SDT, TRACK_EIT, TRACK_NIT, TRACK_PMT, TRACK_COUNT };
+
+static const char* const TRACKED_TABLE_NAMES[TRACK_COUNT] = { "SDT", "EIT", "NIT", "PMT" };
+
+// PID part of the PMT key of a program, beyond all elementary stream PIDs
+static const unsigned PMT_PROGRAM = 0xFFFF;
+
+class ChangeTracker : boost::noncopyable {
+public:
+	explicit ChangeTracker(object parser)
+		: parser_object_(parser), parser_(extract<PythonParser&>(parser)) {
+		for (int i = 0; i < TRACK_COUNT; ++i) {
+			tables_[i].generation = 0;
+			tables_[i].floor = 0;
+			tables_[i].present = 0;
+		}
+		ScopedGILRelease nogil;
+		parser_.AddSectionObserver(&SectionObserver, this);
+	}
+
+	~ChangeTracker() {
+		ScopedGILRelease nogil;
+		parser_.RemoveSectionObserver(&SectionObserver, this);
+	}
+
+	unsigned long long Generation(std::string table) {
+		const TrackedTable tracked = TableByName(table);
+		std::lock_guard<std::mutex> lock(mutex_);
+		return tables_[tracked].generation;
+	}
+
+	// Keys of the entries changed after generation since. "full" is set if
+	// changes before since have been forgotten; added then holds every
+	// current entry.
+	dict GetChanges(std::string table, unsigned long long since) {
+		const TrackedTable tracked = TableByName(table);
+		std::vector<unsigned long long> added, updated, removed;
+		unsigned long long generation;
+		bool full;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			const TableState& state = tables_[tracked];
+			generation = state.generation;
+			full = since < state.floor;
+			if (full) {
+				for (EntryMap::const_iterator it = state.entries.begin(); it != state.entries.end(); ++it)
+					if (it->second.present)
+						added.push_back(it->first);
+			}
+			else {
+				// the first record of a key after since tells whether the
+				// caller has seen the entry; one added and removed since is
+				// not reported at all
+				std::unordered_set<unsigned long long> seen;
+				ChangeLog::const_iterator it = std::upper_bound(state.log.begin(), state.log.end(), since,
+					[](unsigned long long value, const LogRecord& record) { return value < record.generation; });
+				for (; it != state.log.end(); ++it) {
+					EntryMap::const_iterator found = state.entries.find(it->key);
+					if (found == state.entries.end() || !seen.insert(it->key).second)
+						continue;
+					if (!found->second.present) {
+						if (it->was_present)
+							removed.push_back(it->key);
+					}
+					else if (!it->was_present) {
+						added.push_back(it->key);
+					}
+					else {
+						updated.push_back(it->key);
+					}
+				}
+			}
+		}
+
+		dict result;
+		result["generation"] = generation;
+		result["full"] = full;
+		result["added"] = KeyList(tracked, added);
+		result["updated"] = KeyList(tracked, updated);
+		result["removed"] = KeyList(tracked, removed);
+		return result;
+	}
+
+private:
+	// an entry as carried by EIT present/following sections (0) or by
+	// schedule sections (1); other tables only use the first
+	struct Source {
+		Source() : references(0), fingerprint(0) {}
+		unsigned references;
+		unsigned long long fingerprint;
+	};
+
+	struct Entry {
+		Entry() : fingerprint(0), generation(0), present(false) {}
+		Source sources[2];
+		unsigned long long fingerprint;     // as last reported
+		unsigned long long generation;      // last change
+		bool present;
+	};
+
+	struct LogRecord {
+		unsigned long long generation;
+		unsigned long long key;
+		bool was_present;                   // before the change
+	};
+
+	typedef std::unordered_map<unsigned long long, Entry> EntryMap;
+	typedef std::vector<std::pair<unsigned long long, unsigned long long> > EntryList;    // key, fingerprint
+	typedef std::deque<LogRecord> ChangeLog;
+
+	struct Section {
+		unsigned crc;
+		EntryList entries;
+	};
+
+	struct SubTable {
+		int version;
+		unsigned last_section_number;
+	};
+
+	struct TableState {
+		EntryMap entries;
+		ChangeLog log;
+		unsigned long long generation;
+		unsigned long long floor;            // changes up to here are forgotten
+		std::size_t present;
+	};
+
+	static TrackedTable TableByName(const std::string& name) {
+		for (int i = 0; i < TRACK_COUNT; ++i)
+			if (name == TRACKED_TABLE_NAMES[i])
+				return static_cast<TrackedTable>(i);
+		PyErr_SetString(PyExc_ValueError, ("table is not tracked: " + name).c_str());
+		throw_error_already_set();
+		return TRACK_COUNT;
+	}
+
+	static list KeyList(TrackedTable table, const std::vector<unsigned long long>& keys) {
+		list result;
+		for (std::size_t i = 0; i < keys.size(); ++i) {
+			const unsigned long long key = keys[i];
+			const int a = static_cast<int>((key >> 48) & 0xFFFF), b = static_cast<int>((key >> 32) & 0xFFFF);
+			const int c = static_cast<int>((key >> 16) & 0xFFFF), d = static_cast<int>(key & 0xFFFF);
+			switch (table) {
+			case TRACK_SDT: result.append(make_tuple(b, c, d)); break;       // onid, tsid, sid
+			case TRACK_EIT: result.append(make_tuple(a, b, c, d)); break;    // onid, tsid, sid, event_id
+			case TRACK_PMT:
+				if (d == PMT_PROGRAM)
+					result.append(make_tuple(c));                            // program_number
+				else
+					result.append(make_tuple(c, d));                         // program_number, es pid
+				break;
+			default: result.append(make_tuple(c, d)); break;                 // onid, tsid
+			}
+		}
+		return result;
+	}
+
+	static unsigned long long PackKey(unsigned a, unsigned b, unsigned c, unsigned d) {
+		return (static_cast<unsigned long long>(a & 0xFFFF) << 48) | (static_cast<unsigned long long>(b & 0xFFFF) << 32)
+			| (static_cast<unsigned long long>(c & 0xFFFF) << 16) | (d & 0xFFFF);
+	}
+
+	static unsigned Word(const unsigned char* data) {
+		return (data[0] << 8) | data[1];
+	}
+
+	// runs on the parsing thread
+	static TS_VOID SectionObserver(TS_PVOID context, unsigned, const unsigned char* section, unsigned length) {
+		const unsigned char table_id = section[0];
+		TrackedTable table;
+		if (table_id == 0x42 || table_id == 0x46)
+			table = TRACK_SDT;
+		else if (table_id >= 0x4E && table_id <= 0x6F)
+			table = TRACK_EIT;
+		else if (table_id == 0x40 || table_id == 0x41)
+			table = TRACK_NIT;
+		else if (table_id == 0x02)
+			table = TRACK_PMT;
+		else
+			return;
+		if (!(section[1] & 0x80) || !(section[5] & 0x01) || length < 12)
+			return;
+		reinterpret_cast<ChangeTracker*>(context)->Update(table, section, length);
+	}
+
+	// Sub-table: table id, table id extension and for SDT and EIT the
+	// original network and transport stream; the section number follows.
+	TS_VOID Update(TrackedTable table, const unsigned char* section, unsigned length) {
+		unsigned long long sub_table = static_cast<unsigned long long>(section[0]) << 48 | static_cast<unsigned long long>(Word(section + 3)) << 32;
+		if (table == TRACK_SDT)
+			sub_table |= static_cast<unsigned long long>(Word(section + 8)) << 16 | Word(section + 3);
+		else if (table == TRACK_EIT)
+			sub_table |= static_cast<unsigned long long>(Word(section + 10)) << 16 | Word(section + 8);
+		const unsigned long long key = sub_table << 8 | section[6];
+		const unsigned crc = static_cast<unsigned>(Word(section + length - 4)) << 16 | Word(section + length - 2);
+		const int slot = table == TRACK_EIT && section[0] >= 0x50 ? 1 : 0;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::unordered_map<unsigned long long, Section>::iterator found = sections_.find(key);
+		if (found != sections_.end() && found->second.crc == crc)
+			return;
+
+		TableState& state = tables_[table];
+		const unsigned long long next = state.generation + 1;
+		bool changed = false;
+
+		// a new version may have fewer sections
+		SubTable fresh = { -1, 0 };
+		SubTable& known = sub_tables_.insert(std::make_pair(sub_table, fresh)).first->second;
+		const int version = (section[5] >> 1) & 0x1F;
+		if (known.version != version) {
+			const unsigned last = section[7];
+			if (known.version >= 0) {
+				for (unsigned number = last + 1; number <= known.last_section_number; ++number) {
+					std::unordered_map<unsigned long long, Section>::iterator stale = sections_.find(sub_table << 8 | number);
+					if (stale == sections_.end())
+						continue;
+					changed |= Replace(state, slot, stale->second.entries, EntryList(), next);
+					sections_.erase(stale);
+				}
+			}
+			known.version = version;
+			known.last_section_number = last;
+			found = sections_.find(key);
+		}
+
+		EntryList entries;
+		ParseEntries(table, section, length, entries);
+		Section& stored = sections_[key];
+		changed |= Replace(state, slot, found == sections_.end() ? EntryList() : stored.entries, entries, next);
+		stored.crc = crc;
+		stored.entries.swap(entries);
+
+		if (changed) {
+			state.generation = next;
+			Trim(state);
+		}
+	}
+
+	// key and fingerprint of every entry of the section
+	static TS_VOID ParseEntries(TrackedTable table, const unsigned char* section, unsigned length, EntryList& entries) {
+		const unsigned end = length - 4;
+		switch (table) {
+		case TRACK_SDT: {
+			const unsigned tsid = Word(section + 3), onid = Word(section + 8);
+			for (unsigned position = 11; position + 5 <= end;) {
+				const unsigned size = 5 + (Word(section + position + 3) & 0x0FFF);
+				if (position + size > end)
+					break;
+				entries.push_back(std::make_pair(PackKey(0, onid, tsid, Word(section + position)), Fingerprint().Add(section + position, size).Value()));
+				position += size;
+			}
+			break;
+		}
+		case TRACK_EIT: {
+			const unsigned sid = Word(section + 3), tsid = Word(section + 8), onid = Word(section + 10);
+			for (unsigned position = 14; position + 12 <= end;) {
+				const unsigned size = 12 + (Word(section + position + 10) & 0x0FFF);
+				if (position + size > end)
+					break;
+				entries.push_back(std::make_pair(PackKey(onid, tsid, sid, Word(section + position)), Fingerprint().Add(section + position, size).Value()));
+				position += size;
+			}
+			break;
+		}
+		case TRACK_NIT: {
+			unsigned position = 10 + (Word(section + 8) & 0x0FFF);
+			if (position + 2 > end)
+				break;
+			position += 2;
+			while (position + 6 <= end) {
+				const unsigned size = 6 + (Word(section + position + 4) & 0x0FFF);
+				if (position + size > end)
+					break;
+				entries.push_back(std::make_pair(PackKey(0, 0, Word(section + position + 2), Word(section + position)), Fingerprint().Add(section + position, size).Value()));
+				position += size;
+			}
+			break;
+		}
+		default: {
+			// the program itself (PCR PID and program descriptors), then
+			// its elementary streams
+			const unsigned program = Word(section + 3);
+			const unsigned streams = 12 + (Word(section + 10) & 0x0FFF);
+			if (streams > end)
+				break;
+			entries.push_back(std::make_pair(PackKey(0, 0, program, PMT_PROGRAM), Fingerprint().Add(section + 8, streams - 8).Value()));
+			for (unsigned position = streams; position + 5 <= end;) {
+				const unsigned size = 5 + (Word(section + position + 3) & 0x0FFF);
+				if (position + size > end)
+					break;
+				entries.push_back(std::make_pair(PackKey(0, 0, program, Word(section + position + 1) & 0x1FFF), Fingerprint().Add(section + position, size).Value()));
+				position += size;
+			}
+			break;
+		}
+		}
+	}
+
+	// Moves the references of a section from its old to its new entries and
+	// logs the entries whose reported state changes. EIT present/following
+	// takes precedence over the schedule for events in both.
+	bool Replace(TableState& state, int slot, const EntryList& before, const EntryList& after, unsigned long long next) {
+		for (std::size_t i = 0; i < before.size(); ++i) {
+			Source& source = state.entries[before[i].first].sources[slot];
+			if (source.references > 0)
+				--source.references;
+		}
+		for (std::size_t i = 0; i < after.size(); ++i) {
+			Source& source = state.entries[after[i].first].sources[slot];
+			++source.references;
+			source.fingerprint = after[i].second;
+		}
+
+		bool changed = false;
+		for (int pass = 0; pass < 2; ++pass) {
+			const EntryList& touched = pass == 0 ? before : after;
+			for (std::size_t i = 0; i < touched.size(); ++i) {
+				const unsigned long long key = touched[i].first;
+				Entry& entry = state.entries[key];
+				const bool present = entry.sources[0].references > 0 || entry.sources[1].references > 0;
+				const unsigned long long fingerprint = entry.sources[0].references > 0 ? entry.sources[0].fingerprint : entry.sources[1].fingerprint;
+				if (present == entry.present && (!present || fingerprint == entry.fingerprint))
+					continue;
+				if (present && !entry.present)
+					++state.present;
+				else if (!present)
+					--state.present;
+				const LogRecord record = { next, key, entry.present };
+				entry.present = present;
+				entry.fingerprint = fingerprint;
+				entry.generation = next;
+				state.log.push_back(record);
+				changed = true;
+			}
+		}
+		return changed;
+	}
+
+	// Expired EIT events would pile up in the log forever; once it is much
+	// longer than the table, the oldest half is forgotten.
+	static TS_VOID Trim(TableState& state) {
+		const std::size_t limit = std::max<std::size_t>(65536, 4 * state.present);
+		if (state.log.size() <= limit)
+			return;
+		while (state.log.size() > limit / 2) {
+			state.floor = state.log.front().generation;
+			state.log.pop_front();
+		}
+		for (EntryMap::iterator it = state.entries.begin(); it != state.entries.end();) {
+			const Entry& entry = it->second;
+			if (!entry.present && entry.generation < state.floor && !entry.sources[0].references && !entry.sources[1].references)
+				it = state.entries.erase(it);
+			else
+				++it;
+		}
+	}
+
+	object parser_object_;
+	PythonParser& parser_;
+	std::mutex mutex_;
+	TableState tables_[TRACK_COUNT];
+	std::unordered_map<unsigned long long, Section> sections_;
+	std::unordered_map<unsigned long long, SubTable> sub_tables_;
+};
+
+#endif // __TSSIPYTHON_CHANGES_H_INCLUDED__
@@ -0,0 +1,148 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_columns.h"
+#include "tssipython_parser.h"
+
+// columnar EIT export
+//
+// Numeric columns are array.array objects (buffer protocol, numpy can wrap
+// them without copying), string columns are lists. The arrays are sized
+// first and filled in place by a single native pass over the table, which
+// runs without the GIL and with the processing lock held.
+
+// array.array type code of the size and signedness of T; "d" if there is
+// none (no 8 byte type on Python 2 for Windows), exact up to 2^53
+template<class T> static const char* ArrayTypeCode() {
+	static const char* const unsigned_codes[] = { "B", "H", "I", "L", "Q", 0 };
+	static const char* const signed_codes[] = { "b", "h", "i", "l", "q", 0 };
+	static const char* code = 0;
+	if (!code) {
+		object array_type = import("array").attr("array");
+		const char* const* candidates = std::is_signed<T>::value ? signed_codes : unsigned_codes;
+		for (; *candidates && !code; ++candidates) {
+			try {
+				if (extract<std::size_t>(array_type(*candidates).attr("itemsize"))() == sizeof(T))
+					code = *candidates;
+			}
+			catch (const error_already_set&) {
+				// type code not supported by this Python version
+				PyErr_Clear();
+			}
+		}
+		if (!code)
+			code = "d";
+	}
+	return code;
+}
+
+// array.array of length zeros, written through its address
+template<class T> class NumericColumn : boost::noncopyable {
+public:
+	explicit NumericColumn(unsigned length) : as_double_(false) {
+		const char* code = ArrayTypeCode<T>();
+		as_double_ = code[0] == 'd';
+		array_ = import("array").attr("array")(code, make_tuple(0)) * length;
+		data_ = length ? reinterpret_cast<unsigned char*>(extract<std::size_t>(array_.attr("buffer_info")()[0])()) : 0;
+	}
+
+	// the array must not be resized while its values are set
+	TS_VOID Set(unsigned index, T value) {
+		if (as_double_)
+			reinterpret_cast<double*>(data_)[index] = static_cast<double>(value);
+		else
+			std::memcpy(data_ + index * sizeof(T), &value, sizeof(T));
+	}
+
+	object Array() const { return array_; }
+
+private:
+	object array_;
+	unsigned char* data_;
+	bool as_double_;
+};
+
+static list StringColumn(const std::vector<std::string>& values, const std::vector<bool>& present) {
+	list result;
+	for (std::size_t i = 0; i < values.size(); ++i)
+		result.append(present[i] ? object(values[i]) : object());
+	return result;
+}
+
+dict EitEventColumns(tssi::Table_Eit& self) {
+	PythonParser& parser = *FindCallbackSlot(&self).parser;
+	std::unique_lock<std::recursive_mutex> lock(parser.ProcessingMutex(), std::defer_lock);
+	unsigned length;
+	{
+		ScopedGILRelease nogil;
+		lock.lock();
+		length = self.GetEventListLength();
+	}
+
+	// sized while the lock keeps the table as it is
+	NumericColumn<decltype(tssi::EitEvent::transport_stream_id)> transport_stream_id(length);
+	NumericColumn<decltype(tssi::EitEvent::original_network_id)> original_network_id(length);
+	NumericColumn<decltype(tssi::EitEvent::service_id)> service_id(length);
+	NumericColumn<decltype(tssi::EitEvent::event_id)> event_id(length);
+	NumericColumn<decltype(tssi::EitEvent::start_time)> start_time(length);
+	NumericColumn<decltype(tssi::EitEvent::duration)> duration(length);
+	NumericColumn<decltype(tssi::EitEvent::running_status)> running_status(length);
+	NumericColumn<decltype(tssi::EitEvent::free_ca_mode)> free_ca_mode(length);
+	std::vector<std::string> name(length);
+	std::vector<std::string> text(length);
+	std::vector<bool> has_short_event(length);
+
+	{
+		ScopedGILRelease nogil;
+		for (unsigned i = 0; i < length; ++i) {
+			const tssi::EitEvent& event = self.GetEvent(i);
+			transport_stream_id.Set(i, event.transport_stream_id);
+			original_network_id.Set(i, event.original_network_id);
+			service_id.Set(i, event.service_id);
+			event_id.Set(i, event.event_id);
+			start_time.Set(i, event.start_time);
+			duration.Set(i, event.duration);
+			running_status.Set(i, event.running_status);
+			free_ca_mode.Set(i, event.free_ca_mode);
+
+			const tssi::Descriptor_ShortEvent* short_event = dynamic_cast<const tssi::Descriptor_ShortEvent*>(event.descriptor_list.GetDescriptorByTag(0x4d));
+			if (short_event) {
+				name[i] = short_event->GetEventName();
+				text[i] = short_event->GetEventText();
+				has_short_event[i] = true;
+			}
+		}
+	}
+	lock.unlock();
+
+	dict result;
+	result["transport_stream_id"] = transport_stream_id.Array();
+	result["original_network_id"] = original_network_id.Array();
+	result["service_id"] = service_id.Array();
+	result["event_id"] = event_id.Array();
+	result["start_time"] = start_time.Array();
+	result["duration"] = duration.Array();
+	result["running_status"] = running_status.Array();
+	result["free_ca_mode"] = free_ca_mode.Array();
+	result["name"] = StringColumn(name, has_short_event);
+	result["text"] = StringColumn(text, has_short_event);
+	return result;
+}
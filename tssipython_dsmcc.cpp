@@ -0,0 +1,112 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_dsmcc.h"
+
+// DSM-CC reassembly and decoding without the GIL
+TS_BOOL DsmccProcessDownload(tssi::Table_Dsmcc& self, unsigned download) {
+	ScopedGILRelease nogil;
+	return self.ProcessDownload(download);
+}
+
+TS_BOOL DsmccDecode(tssi::Table_Dsmcc& self, std::string directory) {
+	ScopedGILRelease nogil;
+	return self.Decode(directory);
+}
+
+#ifndef _WIN32
+// appends the files below root/relative
+bool ListTree(const std::string& root, const std::string& relative, std::vector<std::string>& paths) {
+	DIR* directory = opendir((relative.empty() ? root : root + "/" + relative).c_str());
+	if (!directory)
+		return false;
+	bool ok = true;
+	while (ok) {
+		const dirent* entry = readdir(directory);
+		if (!entry)
+			break;
+		const std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		const std::string child = relative.empty() ? name : relative + "/" + name;
+		struct stat info;
+		if (lstat((root + "/" + child).c_str(), &info) != 0)
+			ok = false;
+		else if (S_ISDIR(info.st_mode))
+			ok = ListTree(root, child, paths);
+		else
+			paths.push_back(child);
+	}
+	closedir(directory);
+	return ok;
+}
+
+void RemoveTree(const std::string& path) {
+	DIR* directory = opendir(path.c_str());
+	if (directory) {
+		while (const dirent* entry = readdir(directory)) {
+			const std::string name = entry->d_name;
+			if (name == "." || name == "..")
+				continue;
+			const std::string child = path + "/" + name;
+			struct stat info;
+			if (lstat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+				RemoveTree(child);
+			else
+				unlink(child.c_str());
+		}
+		closedir(directory);
+	}
+	rmdir(path.c_str());
+}
+
+bool ReadWholeFile(const std::string& path, std::string& content) {
+	FileDescriptor fd(TSSIPY_OPEN(path.c_str(), TSSIPY_OPEN_FLAGS));
+	if (fd.get() < 0)
+		return false;
+	char buffer[65536];
+	for (;;) {
+		const Py_ssize_t got = TSSIPY_READ(fd.get(), buffer, sizeof(buffer));
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got < 0)
+			return false;
+		if (got == 0)
+			return true;
+		content.append(buffer, static_cast<std::size_t>(got));
+	}
+}
+
+// private directory for in-memory output, in shared memory if available
+std::string MakeTemporaryDirectory() {
+	struct stat info;
+	const char* base = "/dev/shm";
+	if (stat(base, &info) != 0 || !S_ISDIR(info.st_mode)) {
+		base = std::getenv("TMPDIR");
+		if (!base || !*base)
+			base = "/tmp";
+	}
+	std::string pattern = std::string(base) + "/tssipython-XXXXXX";
+	std::vector<char> name(pattern.begin(), pattern.end());
+	name.push_back('\0');
+	return mkdtemp(&name[0]) ? std::string(&name[0]) : std::string();
+}
+#endif
@@ -0,0 +1,339 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_DSMCC_H_INCLUDED__
+#define __TSSIPYTHON_DSMCC_H_INCLUDED__
+
+#include "tssipython_parser.h"
+
+// DSM-CC reassembly and decoding without the GIL
+TS_BOOL DsmccProcessDownload(tssi::Table_Dsmcc& self, unsigned download);
+TS_BOOL DsmccDecode(tssi::Table_Dsmcc& self, std::string directory);
+
+// background DSM-CC decoding
+//
+// libtssi reassembles the carousel of one PID per parser. The decoder runs a
+// private tssi::Parser per carousel PID on its own thread and copies the
+// carousel packets over from a tap on the wrapped parser, so reassembly,
+// inflation of compressed modules and decoding of different carousels run in
+// parallel with each other and with parsing. A download is decoded as soon
+// as its last module has arrived, and again whenever it completes anew.
+
+struct DecodedDownload {
+	int pid;
+	unsigned download;
+	std::string directory;               // empty for in-memory output
+	std::vector<std::string> paths;      // relative, sorted
+	std::vector<std::string> contents;   // in-memory output only
+	std::string error;
+	double seconds;
+};
+
+#ifndef _WIN32
+// appends the files below root/relative
+bool ListTree(const std::string& root, const std::string& relative, std::vector<std::string>& paths);
+void RemoveTree(const std::string& path);
+bool ReadWholeFile(const std::string& path, std::string& content);
+// private directory for in-memory output, in shared memory if available
+std::string MakeTemporaryDirectory();
+#endif
+
+class DsmccDecoder : boost::noncopyable {
+public:
+	// pids: carousel PIDs; output: directory for the decoded downloads, or
+	// None to return file contents instead; queue_packets: packets waiting
+	// per carousel, beyond which new carousel packets are dropped
+	DsmccDecoder(object parser, object pids, object output, std::size_t queue_packets)
+		: parser_object_(parser), parser_(extract<PythonParser&>(parser)),
+		  in_memory_(output.is_none()), queue_limit_(std::max<std::size_t>(queue_packets, 1) * 188),
+		  pid_carousels_(8192, -1), stop_(false), tapped_(false), dropped_(0) {
+		if (!in_memory_) {
+			output_ = extract<std::string>(output);
+			if (TSSIPY_MKDIR(output_.c_str()) != 0 && errno != EEXIST)
+				RaiseIOError(output_);
+		}
+#ifdef _WIN32
+		else {
+			PyErr_SetString(PyExc_ValueError, "in-memory output is not supported on Windows");
+			throw_error_already_set();
+		}
+#endif
+		stl_input_iterator<unsigned> begin(pids), end;
+		for (; begin != end; ++begin) {
+			const unsigned pid = *begin & 0x1FFF;
+			if (pid_carousels_[pid] >= 0)
+				continue;
+			pid_carousels_[pid] = static_cast<int>(carousels_.size());
+			carousels_.push_back(std::unique_ptr<Carousel>(new Carousel(pid)));
+		}
+		if (carousels_.empty()) {
+			PyErr_SetString(PyExc_ValueError, "no carousel PIDs given");
+			throw_error_already_set();
+		}
+
+		for (std::size_t i = 0; i < carousels_.size(); ++i)
+			carousels_[i]->thread = std::thread(&DsmccDecoder::CarouselLoop, this, carousels_[i].get());
+		ScopedGILRelease nogil;
+		parser_.AddTap(&CarouselTap, this);
+		tapped_ = true;
+	}
+
+	~DsmccDecoder() {
+		ScopedGILRelease nogil;
+		Shutdown();
+	}
+
+	// stops decoding, carousel data not yet processed is discarded; waits
+	// for the buffer the parser is processing
+	void Stop() {
+		ScopedGILRelease nogil;
+		Shutdown();
+	}
+
+	// waits until all carousel data handed over so far is processed and
+	// decoded; returns false if the timeout (seconds, negative: none) expired
+	bool Wait(double timeout) {
+		ScopedGILRelease nogil;
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<long long>(timeout * 1e6));
+		while (!Idle()) {
+			if (timeout >= 0 && std::chrono::steady_clock::now() >= deadline)
+				return false;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	// carousel packets dropped because a carousel queue was full
+	unsigned long long Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+	// downloads decoded since the last call, in completion order
+	list PollCompleted() {
+		std::vector<DecodedDownload> completed;
+		{
+			std::lock_guard<std::mutex> lock(completed_mutex_);
+			completed.swap(completed_);
+		}
+		list result;
+		for (std::size_t i = 0; i < completed.size(); ++i)
+			result.append(DownloadDict(completed[i]));
+		return result;
+	}
+
+private:
+	struct Carousel {
+		explicit Carousel(unsigned carousel_pid) : pid(carousel_pid), busy(false) {
+			parser.SetPidDsmcc(static_cast<TS_WORD>(pid));
+		}
+
+		const unsigned pid;
+		tssi::Parser parser;                   // carousel thread only
+		std::vector<bool> complete;            // carousel thread only
+		std::vector<unsigned char> staging;    // parsing thread only
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::vector<unsigned char> queued;
+		bool busy;
+		std::thread thread;
+	};
+
+	static TS_VOID CarouselTap(TS_PVOID context, const unsigned char* data, unsigned length) {
+		reinterpret_cast<DsmccDecoder*>(context)->Tap(data, length);
+	}
+
+	// Copies carousel packets, one hand-over per carousel and buffer. A
+	// carousel that falls behind gets what fits into its queue; carousels
+	// repeat, so the modules of dropped packets come round again.
+	TS_VOID Tap(const unsigned char* data, unsigned length) {
+		for (unsigned position = 0; position + 188 <= length; position += 188) {
+			const unsigned char* packet = data + position;
+			if (packet[0] != 0x47)
+				break;
+			const int carousel = pid_carousels_[((packet[1] & 0x1F) << 8) | packet[2]];
+			if (carousel >= 0) {
+				std::vector<unsigned char>& staging = carousels_[carousel]->staging;
+				staging.insert(staging.end(), packet, packet + 188);
+			}
+		}
+		for (std::size_t i = 0; i < carousels_.size(); ++i) {
+			Carousel& carousel = *carousels_[i];
+			if (carousel.staging.empty())
+				continue;
+			std::size_t taken;
+			{
+				std::lock_guard<std::mutex> lock(carousel.mutex);
+				const std::size_t room = carousel.queued.size() < queue_limit_ ? queue_limit_ - carousel.queued.size() : 0;
+				taken = std::min(room, carousel.staging.size());
+				carousel.queued.insert(carousel.queued.end(), carousel.staging.begin(), carousel.staging.begin() + taken);
+			}
+			if (taken < carousel.staging.size())
+				Bump(dropped_, (carousel.staging.size() - taken) / 188);
+			if (taken > 0)
+				carousel.wakeup.notify_one();
+			carousel.staging.clear();
+		}
+	}
+
+	void CarouselLoop(Carousel* carousel) {
+		std::vector<unsigned char> packets;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(carousel->mutex);
+				carousel->busy = false;
+				while (!stop_.load() && carousel->queued.empty())
+					carousel->wakeup.wait(lock);
+				if (stop_.load())
+					break;
+				packets.swap(carousel->queued);
+				carousel->busy = true;
+			}
+
+			carousel->parser.Process(&packets[0], static_cast<unsigned>(packets.size()));
+			packets.clear();
+
+			tssi::Table_Dsmcc& table = carousel->parser.TableDsmcc();
+			const unsigned downloads = table.GetDownloadListLength();
+			if (carousel->complete.size() < downloads)
+				carousel->complete.resize(downloads, false);
+			for (unsigned i = 0; i < downloads && !stop_.load(std::memory_order_relaxed); ++i) {
+				const bool complete = table.IsDownloadComplete(i) != 0;
+				if (complete && !carousel->complete[i])
+					Decode(*carousel, i);
+				carousel->complete[i] = complete;
+			}
+		}
+	}
+
+	void Decode(Carousel& carousel, unsigned download) {
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		DecodedDownload result;
+		result.pid = static_cast<int>(carousel.pid);
+		result.download = download;
+		result.seconds = 0;
+
+		std::string temporary, target;
+#ifndef _WIN32
+		if (in_memory_) {
+			temporary = MakeTemporaryDirectory();
+			if (temporary.empty())
+				result.error = "cannot create temporary directory";
+			target = temporary + "/data";
+		}
+		else
+#endif
+		{
+			result.directory = output_ + "/pid" + std::to_string(carousel.pid) + "_" + std::to_string(download);
+			target = result.directory;
+		}
+
+		tssi::Table_Dsmcc& table = carousel.parser.TableDsmcc();
+		if (result.error.empty() && !table.ProcessDownload(download))
+			result.error = "download reassembly failed";
+		else if (result.error.empty() && !table.Decode(target))
+			result.error = "decoding failed";
+#ifndef _WIN32
+		if (result.error.empty()) {
+			if (!ListTree(target, std::string(), result.paths))
+				result.error = "cannot list decoded files";
+			std::sort(result.paths.begin(), result.paths.end());
+		}
+		if (in_memory_ && result.error.empty()) {
+			result.contents.resize(result.paths.size());
+			for (std::size_t i = 0; i < result.paths.size() && result.error.empty(); ++i)
+				if (!ReadWholeFile(target + "/" + result.paths[i], result.contents[i]))
+					result.error = "cannot read decoded file " + result.paths[i];
+		}
+		if (!temporary.empty())
+			RemoveTree(temporary);
+#endif
+		result.seconds = Nanoseconds(start) * 1e-9;
+
+		std::lock_guard<std::mutex> lock(completed_mutex_);
+		completed_.push_back(std::move(result));
+	}
+
+	bool Idle() {
+		for (std::size_t i = 0; i < carousels_.size(); ++i) {
+			std::lock_guard<std::mutex> lock(carousels_[i]->mutex);
+			if (carousels_[i]->busy || !carousels_[i]->queued.empty())
+				return false;
+		}
+		return true;
+	}
+
+	// called without the GIL
+	void Shutdown() {
+		if (tapped_) {
+			parser_.RemoveTap(&CarouselTap, this);
+			tapped_ = false;
+		}
+		stop_.store(true);
+		for (std::size_t i = 0; i < carousels_.size(); ++i) {
+			Carousel& carousel = *carousels_[i];
+			{
+				std::lock_guard<std::mutex> lock(carousel.mutex);
+				carousel.queued.clear();
+			}
+			carousel.wakeup.notify_one();
+			if (carousel.thread.joinable())
+				carousel.thread.join();
+		}
+	}
+
+	// files maps paths to bytes for in-memory output, otherwise it lists
+	// the paths below directory; error is None on success
+	dict DownloadDict(const DecodedDownload& download) const {
+		dict result;
+		result["pid"] = download.pid;
+		result["download"] = download.download;
+		result["directory"] = download.directory.empty() ? object() : object(download.directory);
+		result["error"] = download.error.empty() ? object() : object(download.error);
+		result["seconds"] = download.seconds;
+		if (in_memory_) {
+			dict files;
+			for (std::size_t i = 0; i < download.contents.size(); ++i)
+				files[download.paths[i]] = object(handle<>(PyBytes_FromStringAndSize(download.contents[i].data(), static_cast<Py_ssize_t>(download.contents[i].size()))));
+			result["files"] = files;
+		}
+		else {
+			list files;
+			for (std::size_t i = 0; i < download.paths.size(); ++i)
+				files.append(download.paths[i]);
+			result["files"] = files;
+		}
+		return result;
+	}
+
+	object parser_object_;
+	PythonParser& parser_;
+	const bool in_memory_;
+	const std::size_t queue_limit_;      // bytes per carousel
+	std::string output_;
+	std::vector<int> pid_carousels_;
+	std::vector<std::unique_ptr<Carousel> > carousels_;
+	std::atomic<bool> stop_;
+	bool tapped_;
+	Counter dropped_;
+
+	std::mutex completed_mutex_;
+	std::vector<DecodedDownload> completed_;
+};
+
+#endif // __TSSIPYTHON_DSMCC_H_INCLUDED__
@@ -0,0 +1,83 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_index.h"
+#include "tssipython_parser.h"
+
+// indexed SDT and EIT lookups
+//
+// Entries are returned through the getters of the table object, so they
+// keep the parser alive like GetServiceDescription and GetEvent results.
+// Lookups wait for the buffer being processed and fetch the entries before
+// the lock is released, so another buffer cannot move them in between.
+
+static int OptionalId(object value) {
+	return value.is_none() ? -1 : static_cast<int>(extract<unsigned>(value));
+}
+
+object SdtFindService(object self, unsigned service_id, object original_network_id, object transport_stream_id) {
+	tssi::Table_Sdt& sdt = extract<tssi::Table_Sdt&>(self);
+	PythonParser& parser = *FindCallbackSlot(&sdt).parser;
+	const int onid = OptionalId(original_network_id), tsid = OptionalId(transport_stream_id);
+	std::unique_lock<std::recursive_mutex> lock(parser.ProcessingMutex(), std::defer_lock);
+	int index;
+	{
+		ScopedGILRelease nogil;
+		lock.lock();
+		index = parser.Index().FindService(sdt, service_id, onid, tsid);
+	}
+	return index < 0 ? object() : self.attr("GetServiceDescription")(index);
+}
+
+object EitFindEvent(object self, unsigned service_id, unsigned event_id, object original_network_id, object transport_stream_id) {
+	tssi::Table_Eit& eit = extract<tssi::Table_Eit&>(self);
+	PythonParser& parser = *FindCallbackSlot(&eit).parser;
+	const int onid = OptionalId(original_network_id), tsid = OptionalId(transport_stream_id);
+	std::unique_lock<std::recursive_mutex> lock(parser.ProcessingMutex(), std::defer_lock);
+	int index;
+	{
+		ScopedGILRelease nogil;
+		lock.lock();
+		index = parser.Index().FindEvent(eit, service_id, event_id, onid, tsid);
+	}
+	return index < 0 ? object() : self.attr("GetEvent")(index);
+}
+
+// events of a service overlapping [start, end), in seconds since 1970 UTC
+list EitFindEvents(object self, unsigned service_id, object start, object end, object original_network_id, object transport_stream_id) {
+	tssi::Table_Eit& eit = extract<tssi::Table_Eit&>(self);
+	PythonParser& parser = *FindCallbackSlot(&eit).parser;
+	const int onid = OptionalId(original_network_id), tsid = OptionalId(transport_stream_id);
+	const long long from = start.is_none() ? LLONG_MIN : extract<long long>(start)();
+	const long long to = end.is_none() ? LLONG_MAX : extract<long long>(end)();
+	std::unique_lock<std::recursive_mutex> lock(parser.ProcessingMutex(), std::defer_lock);
+	std::vector<unsigned> indices;
+	{
+		ScopedGILRelease nogil;
+		lock.lock();
+		parser.Index().FindEvents(eit, service_id, onid, tsid, from, to, indices);
+	}
+	object get_event = self.attr("GetEvent");
+	list result;
+	for (std::size_t i = 0; i < indices.size(); ++i)
+		result.append(get_event(indices[i]));
+	return result;
+}
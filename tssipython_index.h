@@ -0,0 +1,235 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_INDEX_H_INCLUDED__
+#define __TSSIPYTHON_INDEX_H_INCLUDED__
+
+#include "tssipython.h"
+
+// SDT and EIT indexes
+//
+// libtssi does not tell which entries a section changed, so an index is
+// rebuilt in one native pass on the first lookup after a new or changed
+// section of its table has passed the parser; repeated sections, the bulk
+// of SDT and EIT traffic, leave it alone. Services are keyed by original
+// network, transport stream and service id; each service has an event
+// timeline sorted by start time.
+
+// BCD hh:mm:ss in seconds
+inline long long BcdDuration(unsigned value) {
+	const unsigned hours = ((value >> 20) & 0x0F) * 10 + ((value >> 16) & 0x0F);
+	const unsigned minutes = ((value >> 12) & 0x0F) * 10 + ((value >> 8) & 0x0F);
+	const unsigned seconds = ((value >> 4) & 0x0F) * 10 + (value & 0x0F);
+	return hours * 3600LL + minutes * 60LL + seconds;
+}
+
+// DVB UTC (MJD and BCD hh:mm:ss) in seconds since 1970, -1 if undefined
+inline long long DvbTime(unsigned long long value) {
+	if ((value & 0xFFFFFFFFFFULL) == 0xFFFFFFFFFFULL)
+		return -1;
+	const long long mjd = static_cast<long long>((value >> 24) & 0xFFFF);
+	return (mjd - 40587) * 86400 + BcdDuration(static_cast<unsigned>(value & 0xFFFFFF));
+}
+
+class TableIndex : boost::noncopyable {
+public:
+	TableIndex() : sdt_stamp_(0), sdt_built_(0), sdt_length_(0), sdt_valid_(false), eit_stamp_(0), eit_built_(0), eit_length_(0), eit_valid_(false) {}
+
+	// section observer of the owning parser; runs under its processing
+	// lock, as do the lookups
+	static TS_VOID SectionObserver(TS_PVOID context, unsigned, const unsigned char* section, unsigned length) {
+		reinterpret_cast<TableIndex*>(context)->Stamp(section, length);
+	}
+
+	// ids below 0 match any value; first matching service in table order,
+	// -1 if there is none
+	int FindService(const tssi::Table_Sdt& sdt, unsigned service_id, int original_network_id, int transport_stream_id) {
+		RefreshSdt(sdt);
+		int found = -1;
+		std::pair<KeyMap::const_iterator, KeyMap::const_iterator> range = sdt_keys_.equal_range(service_id);
+		for (KeyMap::const_iterator it = range.first; it != range.second; ++it) {
+			if (!Matches(it->second, original_network_id, transport_stream_id))
+				continue;
+			const int index = static_cast<int>(services_.find(it->second)->second);
+			if (found < 0 || index < found)
+				found = index;
+		}
+		return found;
+	}
+
+	int FindEvent(const tssi::Table_Eit& eit, unsigned service_id, unsigned event_id, int original_network_id, int transport_stream_id) {
+		RefreshEit(eit);
+		int found = -1;
+		std::pair<KeyMap::const_iterator, KeyMap::const_iterator> range = eit_keys_.equal_range(service_id);
+		for (KeyMap::const_iterator it = range.first; it != range.second; ++it) {
+			if (!Matches(it->second, original_network_id, transport_stream_id))
+				continue;
+			std::unordered_map<unsigned long long, unsigned>::const_iterator event = events_.find(it->second << 16 | event_id);
+			if (event != events_.end() && (found < 0 || static_cast<int>(event->second) < found))
+				found = static_cast<int>(event->second);
+		}
+		return found;
+	}
+
+	// events overlapping [start, end), by start time
+	void FindEvents(const tssi::Table_Eit& eit, unsigned service_id, int original_network_id, int transport_stream_id,
+			long long start, long long end, std::vector<unsigned>& result) {
+		RefreshEit(eit);
+		std::vector<const TimelineEntry*> matches;
+		std::pair<KeyMap::const_iterator, KeyMap::const_iterator> range = eit_keys_.equal_range(service_id);
+		unsigned timelines = 0;
+		for (KeyMap::const_iterator it = range.first; it != range.second; ++it) {
+			if (!Matches(it->second, original_network_id, transport_stream_id))
+				continue;
+			++timelines;
+			const std::vector<TimelineEntry>& timeline = timelines_.find(it->second)->second;
+			// reach is the running maximum of the end times, so it is sorted
+			std::vector<TimelineEntry>::const_iterator entry = std::upper_bound(timeline.begin(), timeline.end(), start,
+				[](long long time, const TimelineEntry& candidate) { return time < candidate.reach; });
+			for (; entry != timeline.end() && entry->start < end; ++entry)
+				if (entry->end > start)
+					matches.push_back(&*entry);
+		}
+		if (timelines > 1)
+			std::stable_sort(matches.begin(), matches.end(), [](const TimelineEntry* a, const TimelineEntry* b) { return a->start < b->start; });
+		for (std::size_t i = 0; i < matches.size(); ++i)
+			result.push_back(matches[i]->index);
+	}
+
+	void Clear() {
+		sdt_valid_ = false;
+		eit_valid_ = false;
+		crcs_.clear();
+	}
+
+private:
+	typedef std::unordered_multimap<unsigned, unsigned long long> KeyMap;
+
+	struct TimelineEntry {
+		long long start;
+		long long end;
+		long long reach;
+		unsigned index;
+	};
+
+	static unsigned long long ServiceKey(unsigned original_network_id, unsigned transport_stream_id, unsigned service_id) {
+		return static_cast<unsigned long long>(original_network_id) << 32 | static_cast<unsigned long long>(transport_stream_id) << 16 | service_id;
+	}
+
+	static bool Matches(unsigned long long key, int original_network_id, int transport_stream_id) {
+		return (original_network_id < 0 || static_cast<unsigned>(key >> 32) == static_cast<unsigned>(original_network_id))
+			&& (transport_stream_id < 0 || static_cast<unsigned>(key >> 16 & 0xFFFF) == static_cast<unsigned>(transport_stream_id));
+	}
+
+	// Stamps the table of an SDT or EIT section that is new or differs from
+	// the last copy of the same section, judged by its CRC.
+	void Stamp(const unsigned char* section, unsigned length) {
+		const unsigned char table_id = section[0];
+		const bool sdt = table_id == 0x42 || table_id == 0x46;
+		if ((!sdt && (table_id < 0x4E || table_id > 0x6F)) || !(section[1] & 0x80) || length < 16)
+			return;
+		// table id, extension, onid (SDT) or tsid and onid (EIT), section number
+		const unsigned long long key = static_cast<unsigned long long>(table_id) << 56 | static_cast<unsigned long long>(section[3] << 8 | section[4]) << 40
+			| static_cast<unsigned long long>(section[8] << 8 | section[9]) << 24 | (sdt ? 0 : section[10] << 8 | section[11]) << 8 | section[6];
+		const unsigned crc = static_cast<unsigned>(section[length - 4]) << 24 | section[length - 3] << 16 | section[length - 2] << 8 | section[length - 1];
+		std::unordered_map<unsigned long long, unsigned>::iterator it = crcs_.find(key);
+		if (it != crcs_.end() && it->second == crc)
+			return;
+		crcs_[key] = crc;
+		++(sdt ? sdt_stamp_ : eit_stamp_);
+	}
+
+	void RefreshSdt(const tssi::Table_Sdt& sdt) {
+		const unsigned length = sdt.GetServiceListLength();
+		if (sdt_valid_ && sdt_stamp_ == sdt_built_ && length == sdt_length_)
+			return;
+		services_.clear();
+		sdt_keys_.clear();
+		for (unsigned i = 0; i < length; ++i) {
+			const tssi::ServiceDescription& service = sdt.GetServiceDescription(i);
+			const unsigned long long key = ServiceKey(service.original_network_id, service.transport_stream_id, service.service_id);
+			if (services_.insert(std::make_pair(key, i)).second)
+				sdt_keys_.insert(std::make_pair(static_cast<unsigned>(service.service_id), key));
+		}
+		sdt_built_ = sdt_stamp_;
+		sdt_length_ = length;
+		sdt_valid_ = true;
+	}
+
+	// events listed twice (present/following and schedule) are indexed
+	// once, by their first entry
+	void RefreshEit(const tssi::Table_Eit& eit) {
+		const unsigned length = eit.GetEventListLength();
+		if (eit_valid_ && eit_stamp_ == eit_built_ && length == eit_length_)
+			return;
+		events_.clear();
+		eit_keys_.clear();
+		timelines_.clear();
+		for (unsigned i = 0; i < length; ++i) {
+			const tssi::EitEvent& event = eit.GetEvent(i);
+			const unsigned long long key = ServiceKey(event.original_network_id, event.transport_stream_id, event.service_id);
+			if (!events_.insert(std::make_pair(key << 16 | event.event_id, i)).second)
+				continue;
+			std::vector<TimelineEntry>& timeline = timelines_[key];
+			if (timeline.empty())
+				eit_keys_.insert(std::make_pair(static_cast<unsigned>(event.service_id), key));
+			const long long start = DvbTime(event.start_time);
+			if (start < 0)
+				continue;
+			TimelineEntry entry = { start, start + BcdDuration(event.duration), 0, i };
+			timeline.push_back(entry);
+		}
+		for (std::unordered_map<unsigned long long, std::vector<TimelineEntry> >::iterator it = timelines_.begin(); it != timelines_.end(); ++it) {
+			std::vector<TimelineEntry>& timeline = it->second;
+			std::stable_sort(timeline.begin(), timeline.end(), [](const TimelineEntry& a, const TimelineEntry& b) { return a.start < b.start; });
+			long long reach = 0;
+			for (std::size_t i = 0; i < timeline.size(); ++i)
+				timeline[i].reach = reach = std::max(reach, timeline[i].end);
+		}
+		eit_built_ = eit_stamp_;
+		eit_length_ = length;
+		eit_valid_ = true;
+	}
+
+	std::unordered_map<unsigned long long, unsigned> services_;   // service key -> SDT index
+	KeyMap sdt_keys_;                                             // service id -> service keys
+	unsigned long long sdt_stamp_;                                // new or changed sections seen
+	unsigned long long sdt_built_;                                // stamp the index was built at
+	unsigned sdt_length_;
+	bool sdt_valid_;
+
+	std::unordered_map<unsigned long long, unsigned> events_;     // service key, event id -> EIT index
+	std::unordered_map<unsigned long long, std::vector<TimelineEntry> > timelines_;
+	KeyMap eit_keys_;
+	unsigned long long eit_stamp_;
+	unsigned long long eit_built_;
+	unsigned eit_length_;
+	bool eit_valid_;
+
+	std::unordered_map<unsigned long long, unsigned> crcs_;      // section -> CRC
+};
+
+// Table_Sdt.FindService, Table_Eit.FindEvent and Table_Eit.FindEvents
+object SdtFindService(object self, unsigned service_id, object original_network_id, object transport_stream_id);
+object EitFindEvent(object self, unsigned service_id, unsigned event_id, object original_network_id, object transport_stream_id);
+list EitFindEvents(object self, unsigned service_id, object start, object end, object original_network_id, object transport_stream_id);
+
+#endif // __TSSIPYTHON_INDEX_H_INCLUDED__
@@ -0,0 +1,210 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_ingest.h"
+
+// TS_BYTE* / unsigned interface of tssi::Parser::Process, split into
+// chunks for buffers beyond 2 GB; runs without the GIL, Python callbacks
+// take it back in PythonParser::Dispatch
+TS_BOOL ParserProcessRaw(PythonParser& self, unsigned char* data, Py_ssize_t length) {
+	const Py_ssize_t max_chunk = static_cast<Py_ssize_t>(0x7FFFFFFF / 188 * 188);
+	TS_BOOL result = 1;
+	{
+		ScopedGILRelease nogil;
+		while (length > 0) {
+			const Py_ssize_t chunk = length < max_chunk ? length : max_chunk;
+			result = self.ProcessData(data, static_cast<unsigned>(chunk)) && result;
+			data += chunk;
+			length -= chunk;
+		}
+	}
+	self.DeliverEvents();
+	return result;
+}
+
+TS_BOOL ParserProcessPython(PythonParser& self, object py_buffer) {
+	{
+		PythonBuffer buffer(py_buffer);
+		if (buffer.valid())
+			return ParserProcessRaw(self, buffer.data(), buffer.length());
+	}
+
+	// Objects without buffer interface (e.g. lists of ints) are copied
+	// element-wise into a local buffer with known contiguous memory.
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	object py_iter(handle<>(PyObject_GetIter(py_buffer.ptr())));
+	stl_input_iterator<unsigned char> begin(py_iter), end;
+	std::vector<unsigned char> buffer(begin, end);
+	self.AddCopyTime(Nanoseconds(start));
+	if (buffer.empty())
+		return 1;
+
+	return ParserProcessRaw(self, &buffer[0], static_cast<Py_ssize_t>(buffer.size()));
+}
+
+// streaming file and descriptor ingest
+//
+// Both paths keep memory constant: regular files are mapped window by
+// window, everything else (pipes, dvr devices, sockets) is read into one
+// reusable packet aligned buffer.
+
+// Reads up to length bytes (all data for length < 0) from fd. Incomplete
+// packets at the end of a read are carried over to the next one, only a
+// trailing fragment at end of file is passed on as is.
+// Returns the number of bytes handed to the parser, result is and-ed with
+// every Process result.
+static unsigned long long ParserProcessStream(PythonParser& self, int fd, std::size_t chunk_size, long long length, const std::string& name, TS_BOOL& result) {
+	chunk_size = PacketAlignedChunk(chunk_size);
+	std::vector<unsigned char> buffer(chunk_size);
+	std::size_t filled = 0;
+	unsigned long long processed = 0;
+
+	for (;;) {
+		std::size_t want = chunk_size - filled;
+		if (length >= 0 && static_cast<unsigned long long>(length) < want)
+			want = static_cast<std::size_t>(length);
+
+		Py_ssize_t got = 0;
+		int error = 0;
+		if (want > 0) {
+			ScopedGILRelease nogil;
+			got = TSSIPY_READ(fd, &buffer[filled], want);
+			if (got < 0)
+				error = errno;
+		}
+		if (got < 0) {
+			errno = error;
+			if (error != EINTR)
+				RaiseIOError(name);
+			CheckSignals();
+			continue;
+		}
+
+		if (length >= 0)
+			length -= got;
+		filled += static_cast<std::size_t>(got);
+
+		const bool done = got == 0;
+		const std::size_t complete = done ? filled : filled / 188 * 188;
+		if (complete > 0)
+			result = ParserProcessRaw(self, &buffer[0], static_cast<Py_ssize_t>(complete)) && result;
+		processed += complete;
+		filled -= complete;
+		if (filled > 0)
+			std::memmove(&buffer[0], &buffer[complete], filled);
+
+		if (done)
+			break;
+		CheckSignals();
+	}
+	return processed;
+}
+
+#ifndef _WIN32
+// Maps [offset, end) window by window. Pages are mapped copy-on-write, so
+// libtssi may write to its input as it does with Process buffers.
+static unsigned long long ParserProcessMapped(PythonParser& self, int fd, unsigned long long offset, unsigned long long end, std::size_t chunk_size, const std::string& name, TS_BOOL& result) {
+	chunk_size = PacketAlignedChunk(chunk_size);
+	const unsigned long long page = static_cast<unsigned long long>(sysconf(_SC_PAGESIZE));
+	unsigned long long position = offset;
+
+	while (position < end) {
+		const std::size_t window = static_cast<std::size_t>(end - position < chunk_size ? end - position : chunk_size);
+		const unsigned long long map_start = position / page * page;
+		const std::size_t map_length = static_cast<std::size_t>(position - map_start) + window;
+
+		void* map = mmap(0, map_length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, static_cast<off_t>(map_start));
+		if (map == MAP_FAILED)
+			RaiseIOError(name);
+		madvise(map, map_length, MADV_SEQUENTIAL);
+
+		result = ParserProcessRaw(self, static_cast<unsigned char*>(map) + (position - map_start), static_cast<Py_ssize_t>(window)) && result;
+		munmap(map, map_length);
+
+		position += window;
+		CheckSignals();
+	}
+	return position - offset;
+}
+#endif
+
+// (bytes processed, Process result)
+tuple ParserProcessFile(PythonParser& self, std::string path, std::size_t chunk_size, unsigned long long offset, long long length) {
+	TS_BOOL result = 1;
+	FileDescriptor file(TSSIPY_OPEN(path.c_str(), TSSIPY_OPEN_FLAGS));
+	if (file.get() < 0)
+		RaiseIOError(path);
+
+#ifndef _WIN32
+	struct stat info;
+	if (fstat(file.get(), &info) != 0)
+		RaiseIOError(path);
+	if (S_ISREG(info.st_mode)) {
+		const unsigned long long size = static_cast<unsigned long long>(info.st_size);
+		if (offset >= size)
+			return make_tuple(0, result);
+		unsigned long long end = size;
+		if (length >= 0 && static_cast<unsigned long long>(length) < size - offset)
+			end = offset + static_cast<unsigned long long>(length);
+		const unsigned long long processed = ParserProcessMapped(self, file.get(), offset, end, chunk_size, path, result);
+		return make_tuple(processed, result);
+	}
+#endif
+
+	if (offset > 0 && TSSIPY_SEEK(file.get(), offset) < 0)
+		RaiseIOError(path);
+	const unsigned long long processed = ParserProcessStream(self, file.get(), chunk_size, length, path, result);
+	return make_tuple(processed, result);
+}
+
+// fd may be an integer or an object with a fileno() method; the
+// descriptor is read from its current position and is not closed. File
+// objects buffer ahead of their descriptor, so the descriptor is first
+// moved to tell() and the object is moved past the processed data after.
+// Objects without tell() (sockets) are read as they are.
+tuple ParserProcessFd(PythonParser& self, object py_fd, std::size_t chunk_size, long long length) {
+	const int fd = PyObject_AsFileDescriptor(py_fd.ptr());
+	if (fd < 0)
+		throw_error_already_set();
+
+	const bool file_object = PyObject_HasAttrString(py_fd.ptr(), "tell") != 0;
+	if (file_object) {
+		if (PyObject_HasAttrString(py_fd.ptr(), "flush"))
+			py_fd.attr("flush")();
+		long long position = -1;
+		try {
+			position = extract<long long>(py_fd.attr("tell")());
+		}
+		catch (const error_already_set&) {
+			PyErr_Clear();
+		}
+		if (position < 0 || TSSIPY_SEEK(fd, position) < 0) {
+			PyErr_SetString(PyExc_ValueError, "file object is not seekable, pass its fileno() instead");
+			throw_error_already_set();
+		}
+	}
+
+	TS_BOOL result = 1;
+	const unsigned long long processed = ParserProcessStream(self, fd, chunk_size, length, "<fd>", result);
+	if (file_object)
+		py_fd.attr("seek")(TSSIPY_TELL(fd));
+	return make_tuple(processed, result);
+}
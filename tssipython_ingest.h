@@ -0,0 +1,82 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_INGEST_H_INCLUDED__
+#define __TSSIPYTHON_INGEST_H_INCLUDED__
+
+#include "tssipython_parser.h"
+
+// python buffer wrapper
+//
+// Holds a contiguous read-only view on any object exporting the buffer
+// protocol (bytearray, bytes/str, memoryview, mmap, numpy uint8 arrays).
+// The exporter cannot resize or free its memory while the view is held.
+class PythonBuffer : boost::noncopyable {
+public:
+	explicit PythonBuffer(object py_buffer) : data_(0), length_(0), view_acquired_(false) {
+		PyObject* obj = py_buffer.ptr();
+		if (PyObject_CheckBuffer(obj)) {
+			if (PyObject_GetBuffer(obj, &view_, PyBUF_SIMPLE) != 0)
+				throw_error_already_set();
+			view_acquired_ = true;
+			data_ = static_cast<unsigned char*>(view_.buf);
+			length_ = view_.len;
+			return;
+		}
+#if PY_MAJOR_VERSION < 3
+		// Python 2 mmap and buffer objects only implement the old protocol
+		const void* old_data = 0;
+		Py_ssize_t old_length = 0;
+		if (PyObject_AsReadBuffer(obj, &old_data, &old_length) == 0) {
+			// keep the exporter alive, it has no view to pin it
+			owner_ = py_buffer;
+			data_ = static_cast<unsigned char*>(const_cast<void*>(old_data));
+			length_ = old_length;
+			return;
+		}
+		PyErr_Clear();
+#endif
+	}
+
+	~PythonBuffer() {
+		if (view_acquired_)
+			PyBuffer_Release(&view_);
+	}
+
+	bool valid() const { return view_acquired_ || data_ != 0; }
+	unsigned char* data() const { return data_; }
+	Py_ssize_t length() const { return length_; }
+
+private:
+	Py_buffer view_;
+	object owner_;
+	unsigned char* data_;
+	Py_ssize_t length_;
+	bool view_acquired_;
+};
+
+// Parser.Process, ProcessFile and ProcessFd
+TS_BOOL ParserProcessRaw(PythonParser& self, unsigned char* data, Py_ssize_t length);
+TS_BOOL ParserProcessPython(PythonParser& self, object py_buffer);
+tuple ParserProcessFile(PythonParser& self, std::string path, std::size_t chunk_size, unsigned long long offset, long long length);
+tuple ParserProcessFd(PythonParser& self, object py_fd, std::size_t chunk_size, long long length);
+
+#endif // __TSSIPYTHON_INGEST_H_INCLUDED__
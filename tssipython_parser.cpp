@@ -0,0 +1,101 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_parser.h"
+
+// maps the address of a table or packet object to its slot, so the
+// SetProcessCallback wrappers find the owning parser
+static std::mutex callback_registry_mutex;
+static std::map<const void*, CallbackSlot*> callback_registry;
+
+PythonParser::PythonParser() : current_pid_(-1), attribute_(false), assemble_(false), pid_kinds_(8192, KIND_NONE),
+		pid_ait_(-1), pid_dsmcc_(-1), pid_ebu_(-1), pid_pcr_(-1), ebu_filter_(false), ebu_subtitles_(false),
+		ebu_pages_(8 * 256, false), prescan_(false), pid_filter_(false), packet_size_(188), synced_(true), pid_pass_(8192, 1),
+		filtered_packets_(0), resyncs_(0), statistics_enabled_(false), teletext_seen_(0) {
+	for (int i = 0; i < SOURCE_COUNT; ++i) {
+		slots_[i].parser = this;
+		slots_[i].source = static_cast<EventSource>(i);
+		slots_[i].immediate.store(false);
+		slots_[i].queued.store(false);
+		updates_[i].store(0);
+	}
+	TablePat().SetProcessCallback(&Dispatch, &slots_[SOURCE_PAT]);
+	TablePmt().SetProcessCallback(&Dispatch, &slots_[SOURCE_PMT]);
+	TableSdt().SetProcessCallback(&Dispatch, &slots_[SOURCE_SDT]);
+	TableNit().SetProcessCallback(&Dispatch, &slots_[SOURCE_NIT]);
+	TableEit().SetProcessCallback(&Dispatch, &slots_[SOURCE_EIT]);
+	TableTdt().SetProcessCallback(&Dispatch, &slots_[SOURCE_TDT]);
+	TableAit().SetProcessCallback(&Dispatch, &slots_[SOURCE_AIT]);
+	PacketEbu().SetNewPageCallback(&Dispatch, &slots_[SOURCE_EBU]);
+	PacketPcr().SetPcrCallback(&Dispatch, &slots_[SOURCE_PCR]);
+
+	std::lock_guard<std::mutex> lock(callback_registry_mutex);
+	for (int i = 0; i < SOURCE_COUNT; ++i)
+		callback_registry[SlotOwner(static_cast<EventSource>(i))] = &slots_[i];
+
+	ResetSectionState();
+}
+
+PythonParser::~PythonParser() {
+	std::lock_guard<std::mutex> lock(callback_registry_mutex);
+	for (int i = 0; i < SOURCE_COUNT; ++i)
+		callback_registry.erase(SlotOwner(static_cast<EventSource>(i)));
+}
+
+CallbackSlot* PythonParser::FindSlot(const void* owner) {
+	std::lock_guard<std::mutex> lock(callback_registry_mutex);
+	std::map<const void*, CallbackSlot*>::const_iterator it = callback_registry.find(owner);
+	return it == callback_registry.end() ? 0 : it->second;
+}
+
+// callback wrappers
+//
+// The callback objects are kept by the owning PythonParser for its whole
+// lifetime; None removes a callback.
+CallbackSlot& FindCallbackSlot(const void* owner) {
+	CallbackSlot* slot = PythonParser::FindSlot(owner);
+	if (!slot) {
+		PyErr_SetString(PyExc_ValueError, "object does not belong to a Parser");
+		throw_error_already_set();
+	}
+	return *slot;
+}
+
+TS_VOID SetEbuCallback(tssi::Packet_Ebu& self, object py_callback) {
+	CallbackSlot& slot = FindCallbackSlot(&self);
+	slot.parser->SetCallback(slot.source, py_callback);
+}
+
+// pages: teletext page numbers to keep, see PythonParser::SetEbuFilter
+TS_VOID ParserSetPidEbu(PythonParser& self, TS_WORD pid, bool subtitles_only, object py_pages) {
+	std::vector<unsigned> pages;
+	if (!py_pages.is_none()) {
+		stl_input_iterator<unsigned> begin(py_pages), end;
+		pages.assign(begin, end);
+	}
+	self.SetPidEbu(pid);
+	self.SetEbuFilter(subtitles_only, pages);
+}
+
+TS_VOID SetPcrCallback(tssi::Packet_Pcr& self, object py_callback) {
+	CallbackSlot& slot = FindCallbackSlot(&self);
+	slot.parser->SetCallback(slot.source, py_callback);
+}
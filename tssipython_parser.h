@@ -0,0 +1,955 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_PARSER_H_INCLUDED__
+#define __TSSIPYTHON_PARSER_H_INCLUDED__
+
+#include "tssipython.h"
+#include "tssipython_index.h"
+#include "tssipython_sections.h"
+
+// parser events
+//
+// libtssi reports table, teletext and PCR updates through one callback per
+// object. PythonParser owns these callbacks for its whole lifetime and fans
+// every event out to native observers and then either to the Python
+// callback of the object or to the parser's event queue.
+
+enum EventSource {
+	SOURCE_PAT, SOURCE_PMT, SOURCE_SDT, SOURCE_NIT, SOURCE_EIT, SOURCE_TDT, SOURCE_AIT,
+	SOURCE_EBU, SOURCE_PCR, SOURCE_COUNT
+};
+
+static const char* const EVENT_SOURCE_NAMES[SOURCE_COUNT] = {
+	"PAT", "PMT", "SDT", "NIT", "EIT", "TDT", "AIT", "EBU", "PCR"
+};
+
+static const int TABLE_SOURCES = SOURCE_AIT + 1;
+
+struct ParserEvent {
+	EventSource source;
+	int pid;                     // -1 if unknown
+	int table_id;                // -1 if unknown or not a table
+	int table_id_extension;      // -1 if unknown or not a table
+	int version;                 // -1 if unknown or not versioned
+	unsigned long long value;    // PCR for SOURCE_PCR
+};
+
+typedef TS_VOID (*EventObserver)(TS_PVOID context, const ParserEvent& event);
+
+// sees every buffer before libtssi does
+typedef TS_VOID (*PacketTap)(TS_PVOID context, const unsigned char* data, unsigned length);
+
+// sees every complete section on PIDs of section kinds before libtssi does
+typedef TS_VOID (*SectionObserver)(TS_PVOID context, unsigned pid, const unsigned char* section, unsigned length);
+
+class PythonParser;
+
+struct CallbackSlot {
+	PythonParser* parser;
+	EventSource source;
+	object callback;
+	std::atomic<bool> immediate;
+	std::atomic<bool> queued;
+	std::vector<std::pair<EventObserver, TS_PVOID> > observers;
+};
+
+// parser instrumentation
+//
+// Counters are written by the parsing thread only and read from Python, so
+// relaxed loads and stores suffice. Nothing is collected while disabled.
+
+struct ParserStatistics {
+	ParserStatistics() {
+		Reset();
+	}
+
+	TS_VOID Reset() {
+		for (int i = 0; i < 8192; ++i) {
+			packets[i].store(0, std::memory_order_relaxed);
+			continuity_errors[i].store(0, std::memory_order_relaxed);
+			last_continuity[i] = 0xFF;
+		}
+		for (int i = 0; i < KIND_COUNT; ++i)
+			kind_nanoseconds[i].store(0, std::memory_order_relaxed);
+		bytes.store(0, std::memory_order_relaxed);
+		process_nanoseconds.store(0, std::memory_order_relaxed);
+		callback_nanoseconds.store(0, std::memory_order_relaxed);
+		callbacks.store(0, std::memory_order_relaxed);
+		copy_nanoseconds.store(0, std::memory_order_relaxed);
+	}
+
+	// per-PID packets and continuity counter errors; duplicates and
+	// signalled discontinuities are not counted
+	TS_VOID CountPackets(const unsigned char* data, unsigned length) {
+		for (unsigned position = 0; position + 188 <= length; position += 188) {
+			const unsigned char* packet = data + position;
+			if (packet[0] != 0x47)
+				break;
+			const unsigned pid = ((packet[1] & 0x1F) << 8) | packet[2];
+			Bump(packets[pid], 1);
+			if (pid == 0x1FFF || !(packet[3] & 0x10))
+				continue;
+
+			const unsigned char continuity = packet[3] & 0x0F;
+			const unsigned char last = last_continuity[pid];
+			const bool discontinuity = (packet[3] & 0x20) && packet[4] > 0 && (packet[5] & 0x80);
+			if (last != 0xFF && !discontinuity && continuity != last && continuity != ((last + 1) & 0x0F))
+				Bump(continuity_errors[pid], 1);
+			last_continuity[pid] = continuity;
+		}
+	}
+
+	Counter packets[8192];
+	Counter continuity_errors[8192];
+	Counter kind_nanoseconds[KIND_COUNT];
+	Counter bytes;
+	Counter process_nanoseconds;
+	Counter callback_nanoseconds;
+	Counter callbacks;
+	Counter copy_nanoseconds;
+	unsigned char last_continuity[8192];
+};
+
+// Holds the processing lock of a parser, which is taken for every buffer
+// the parser processes. The GIL is released while waiting for it, so a
+// parsing thread running a Python callback can finish its buffer. Must be
+// taken with the GIL; the lock is recursive, callbacks may take it again.
+class ProcessingLock : boost::noncopyable {
+public:
+	explicit ProcessingLock(std::recursive_mutex& mutex) : lock_(mutex, std::try_to_lock) {
+		if (!lock_.owns_lock()) {
+			ScopedGILRelease nogil;
+			lock_.lock();
+		}
+	}
+
+private:
+	std::unique_lock<std::recursive_mutex> lock_;
+};
+
+// packets of 192 and 204 byte streams are cut to 188 bytes and handed on
+// in batches of this many
+static const unsigned PRESCAN_BATCH = 1024;
+
+class PythonParser : public tssi::Parser {
+public:
+	PythonParser();
+	~PythonParser();
+
+	// the parser owning a table or packet object, 0 if there is none
+	static CallbackSlot* FindSlot(const void* owner);
+
+	TS_VOID Reset() {
+		ProcessingLock lock(processing_mutex_);
+		tssi::Parser::Reset();
+		ResetSectionState();
+		assembler_.Clear();
+		carry_.clear();
+		synced_ = true;
+		if (recorder_)
+			recorder_->Clear();
+		if (index_)
+			index_->Clear();
+	}
+
+	TS_VOID SetPidAit(TS_WORD pid) {
+		ProcessingLock lock(processing_mutex_);
+		tssi::Parser::SetPidAit(pid);
+		pid_ait_ = pid;
+		RebuildPidKinds();
+	}
+
+	TS_VOID SetPidDsmcc(TS_WORD pid) {
+		ProcessingLock lock(processing_mutex_);
+		tssi::Parser::SetPidDsmcc(pid);
+		pid_dsmcc_ = pid;
+		RebuildPidKinds();
+	}
+
+	TS_VOID SetPidEbu(TS_WORD pid) {
+		ProcessingLock lock(processing_mutex_);
+		tssi::Parser::SetPidEbu(pid);
+		pid_ebu_ = pid;
+		RebuildPidKinds();
+	}
+
+	// Teletext pages neither selected by number (magazine * 100 + page,
+	// magazine 8 as 8xx) nor, with subtitles set, flagged as subtitles are
+	// dropped before libtssi sees them. Their headers become time filling
+	// headers (page xFF), which still end the previous page and update the
+	// clock. An empty selection without subtitles disables the filter.
+	TS_VOID SetEbuFilter(bool subtitles, const std::vector<unsigned>& pages) {
+		ProcessingLock lock(processing_mutex_);
+		std::fill(ebu_pages_.begin(), ebu_pages_.end(), false);
+		for (std::size_t i = 0; i < pages.size(); ++i) {
+			const unsigned magazine = pages[i] / 100 % 8;
+			ebu_pages_[magazine * 256 + (pages[i] / 10 % 10 << 4 | pages[i] % 10)] = true;
+		}
+		ebu_subtitles_ = subtitles;
+		ebu_filter_ = subtitles || !pages.empty();
+		std::fill(ebu_keep_, ebu_keep_ + 8, false);
+	}
+
+	// number of events of a source so far, e.g. new teletext pages
+	unsigned long long Updates(EventSource source) const { return updates_[source].load(std::memory_order_relaxed); }
+
+	// SDT and EIT lookups, built on first use; called without the GIL and
+	// with the processing lock held
+	TableIndex& Index() {
+		if (!index_) {
+			index_.reset(new TableIndex());
+			AddSectionObserver(&TableIndex::SectionObserver, index_.get());
+		}
+		return *index_;
+	}
+
+	// Teletext page records, see tssipython_teletext.h: the pages new or
+	// changed since the last call, or one page (empty if not received).
+	// Called without the GIL, both wait for the buffer being processed.
+	std::string UpdatedTeletextPages();
+	std::string TeletextPage(unsigned magazine, unsigned page_number, unsigned sub_page_number);
+
+	TS_VOID SetPidPcr(TS_WORD pid) {
+		ProcessingLock lock(processing_mutex_);
+		tssi::Parser::SetPidPcr(pid);
+		pid_pcr_ = pid;
+	}
+
+	// Packets are dropped before anything else sees them unless their PID is
+	// in allow (None: every PID) and not in deny; both None switch the
+	// filter off. Tables only follow if their PIDs pass, the PAT included.
+	TS_VOID SetPidFilter(object allow, object deny) {
+		std::vector<unsigned char> pass(8192, static_cast<unsigned char>(allow.is_none() ? 1 : 0));
+		if (!allow.is_none()) {
+			stl_input_iterator<unsigned> begin(allow), end;
+			for (; begin != end; ++begin)
+				pass[*begin & 0x1FFF] = 1;
+		}
+		if (!deny.is_none()) {
+			stl_input_iterator<unsigned> begin(deny), end;
+			for (; begin != end; ++begin)
+				pass[*begin & 0x1FFF] = 0;
+		}
+		ProcessingLock lock(processing_mutex_);
+		pid_pass_.swap(pass);
+		pid_filter_ = !allow.is_none() || !deny.is_none();
+		prescan_ = pid_filter_ || packet_size_ != 188;
+	}
+
+	// 188 (TS), 192 (M2TS, timestamp first) or 204 (TS with parity)
+	TS_VOID SetPacketSize(unsigned size) {
+		if (size != 188 && size != 192 && size != 204) {
+			PyErr_SetString(PyExc_ValueError, "packet size must be 188, 192 or 204");
+			throw_error_already_set();
+		}
+		ProcessingLock lock(processing_mutex_);
+		packet_size_ = size;
+		carry_.clear();
+		synced_ = true;
+		prescan_ = pid_filter_ || packet_size_ != 188;
+	}
+
+	// Feeds data to tssi::Parser::Process, called without the GIL.
+	TS_BOOL ProcessData(unsigned char* data, unsigned length) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		return prescan_ ? Prescan(data, length) : ProcessPackets(data, length);
+	}
+
+	// Same for 188 byte packets, bypassing PID filter and packet size
+	TS_BOOL ProcessUnfiltered(unsigned char* data, unsigned length) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		return ProcessPackets(data, length);
+	}
+
+	std::recursive_mutex& ProcessingMutex() { return processing_mutex_; }
+
+	// taps only see the packets passing the PID filter
+	bool HasPidFilter() {
+		ProcessingLock lock(processing_mutex_);
+		return pid_filter_;
+	}
+
+	// keeps the current PSI/SI sections for SaveState; disabling drops them
+	TS_VOID RecordSections(bool enable) {
+		ProcessingLock lock(processing_mutex_);
+		if (!enable)
+			recorder_.reset();
+		else if (!recorder_)
+			recorder_.reset(new SectionRecorder());
+		UpdateAssembly();
+	}
+
+	// the processing lock must be held while the recorder is used
+	const SectionRecorder* Sections() const { return recorder_.get(); }
+
+	// events of the given sources are queued instead of calling the
+	// callbacks of their objects
+	TS_VOID QueueEvents(object sources) {
+		bool queued[SOURCE_COUNT] = { false };
+		stl_input_iterator<std::string> begin(sources), end;
+		for (; begin != end; ++begin)
+			queued[SourceByName(*begin)] = true;
+
+		ProcessingLock lock(processing_mutex_);
+		for (int i = 0; i < SOURCE_COUNT; ++i)
+			slots_[i].queued.store(queued[i]);
+		UpdateAttribution();
+	}
+
+	list PollEvents() {
+		std::vector<ParserEvent> events;
+		{
+			std::lock_guard<std::mutex> lock(events_mutex_);
+			events.swap(events_);
+		}
+		return EventList(events);
+	}
+
+	TS_VOID SetEventCallback(object py_callback) { event_callback_ = py_callback; }
+
+	// hands queued events to the event callback, called with the GIL after
+	// every Process call
+	TS_VOID DeliverEvents() {
+		if (event_callback_.is_none())
+			return;
+		list events = PollEvents();
+		if (len(events) > 0)
+			event_callback_(events);
+	}
+
+	TS_VOID SetCallback(EventSource source, object py_callback) {
+		slots_[source].immediate.store(false);
+		slots_[source].callback = py_callback;
+		slots_[source].immediate.store(!py_callback.is_none());
+	}
+
+	// Observers, taps and section observers run on the parsing thread
+	// without the GIL. Registration waits for the buffer being processed,
+	// so it must be called without the GIL; once removed, an observer is
+	// not called any more.
+	TS_VOID AddObserver(EventSource source, EventObserver observer, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		slots_[source].observers.push_back(std::make_pair(observer, context));
+		UpdateAttribution();
+	}
+
+	TS_VOID RemoveObserver(EventSource source, EventObserver observer, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		std::vector<std::pair<EventObserver, TS_PVOID> >& observers = slots_[source].observers;
+		observers.erase(std::remove(observers.begin(), observers.end(), std::make_pair(observer, context)), observers.end());
+		UpdateAttribution();
+	}
+
+	TS_VOID AddTap(PacketTap tap, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		taps_.push_back(std::make_pair(tap, context));
+	}
+
+	TS_VOID RemoveTap(PacketTap tap, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		taps_.erase(std::remove(taps_.begin(), taps_.end(), std::make_pair(tap, context)), taps_.end());
+	}
+
+	TS_VOID AddSectionObserver(SectionObserver observer, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		section_observers_.push_back(std::make_pair(observer, context));
+		UpdateAssembly();
+	}
+
+	TS_VOID RemoveSectionObserver(SectionObserver observer, TS_PVOID context) {
+		std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+		section_observers_.erase(std::remove(section_observers_.begin(), section_observers_.end(), std::make_pair(observer, context)), section_observers_.end());
+		UpdateAssembly();
+	}
+
+	// both wait for the buffer being processed
+	TS_VOID EnableStatistics(bool enable) {
+		ProcessingLock lock(processing_mutex_);
+		if (enable && !statistics_)
+			statistics_.reset(new ParserStatistics());
+		statistics_enabled_.store(enable);
+	}
+
+	TS_VOID ResetStatistics() {
+		ProcessingLock lock(processing_mutex_);
+		if (statistics_)
+			statistics_->Reset();
+		filtered_packets_.store(0);
+		resyncs_.store(0);
+	}
+
+	TS_VOID AddCopyTime(unsigned long long nanoseconds) {
+		if (statistics_enabled_.load(std::memory_order_relaxed))
+			Bump(statistics_->copy_nanoseconds, nanoseconds);
+	}
+
+	// all counters in one dict; times in seconds, callback time is part of
+	// the time of the packet kind that triggered it
+	dict Statistics() const {
+		dict result;
+		result["enabled"] = statistics_enabled_.load();
+		result["filtered_packets"] = filtered_packets_.load(std::memory_order_relaxed);
+		result["resyncs"] = resyncs_.load(std::memory_order_relaxed);
+		if (!statistics_)
+			return result;
+
+		const ParserStatistics& statistics = *statistics_;
+		const unsigned long long bytes = statistics.bytes.load(std::memory_order_relaxed);
+		const double seconds = statistics.process_nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+		result["bytes"] = bytes;
+		result["process_seconds"] = seconds;
+		result["bytes_per_second"] = seconds > 0 ? bytes / seconds : 0.0;
+		result["callbacks"] = statistics.callbacks.load(std::memory_order_relaxed);
+		result["callback_seconds"] = statistics.callback_nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+		result["copy_seconds"] = statistics.copy_nanoseconds.load(std::memory_order_relaxed) * 1e-9;
+
+		dict kinds;
+		for (int i = KIND_PAT; i < KIND_COUNT; ++i)
+			kinds[PACKET_KIND_NAMES[i]] = statistics.kind_nanoseconds[i].load(std::memory_order_relaxed) * 1e-9;
+		result["kind_seconds"] = kinds;
+
+		dict pids;
+		unsigned long long continuity_errors = 0;
+		for (int pid = 0; pid < 8192; ++pid) {
+			const unsigned long long packets = statistics.packets[pid].load(std::memory_order_relaxed);
+			if (!packets)
+				continue;
+			const unsigned long long errors = statistics.continuity_errors[pid].load(std::memory_order_relaxed);
+			continuity_errors += errors;
+			pids[pid] = make_tuple(packets, errors);
+		}
+		result["pids"] = pids;
+		result["continuity_errors"] = continuity_errors;
+		return result;
+	}
+
+private:
+	struct SectionHeader {
+		int table_id;
+		int table_id_extension;
+		int version;
+	};
+
+	const void* SlotOwner(EventSource source) {
+		switch (source) {
+		case SOURCE_PAT: return &TablePat();
+		case SOURCE_PMT: return &TablePmt();
+		case SOURCE_SDT: return &TableSdt();
+		case SOURCE_NIT: return &TableNit();
+		case SOURCE_EIT: return &TableEit();
+		case SOURCE_TDT: return &TableTdt();
+		case SOURCE_AIT: return &TableAit();
+		case SOURCE_EBU: return &PacketEbu();
+		default: return &PacketPcr();
+		}
+	}
+
+	static bool IsSourceTable(EventSource source, int table_id) {
+		switch (source) {
+		case SOURCE_PAT: return table_id == 0x00;
+		case SOURCE_PMT: return table_id == 0x02;
+		case SOURCE_NIT: return table_id == 0x40 || table_id == 0x41;
+		case SOURCE_SDT: return table_id == 0x42 || table_id == 0x46;
+		case SOURCE_EIT: return table_id >= 0x4E && table_id <= 0x6F;
+		case SOURCE_TDT: return table_id == 0x70 || table_id == 0x73;
+		case SOURCE_AIT: return table_id == 0x74;
+		default: return false;
+		}
+	}
+
+	static EventSource SourceByName(const std::string& name) {
+		for (int i = 0; i < SOURCE_COUNT; ++i)
+			if (name == EVENT_SOURCE_NAMES[i])
+				return static_cast<EventSource>(i);
+		PyErr_SetString(PyExc_ValueError, ("unknown event source " + name).c_str());
+		throw_error_already_set();
+		return SOURCE_COUNT;
+	}
+
+	static list EventList(const std::vector<ParserEvent>& events) {
+		list result;
+		for (std::size_t i = 0; i < events.size(); ++i) {
+			const ParserEvent& event = events[i];
+			result.append(make_tuple(
+				EVENT_SOURCE_NAMES[event.source],
+				event.pid < 0 ? object() : object(event.pid),
+				event.table_id < 0 ? object() : object(event.table_id),
+				event.version < 0 ? object() : object(event.version),
+				event.source == SOURCE_PCR ? object(event.value) : object()));
+		}
+		return result;
+	}
+
+	// Feeds 188 byte packets to libtssi. While table events are queued or
+	// observed, packets on SI PIDs are handed over one by one, so events can
+	// carry PID, table id and version of the section that completed them.
+	// While sections are assembled, PAT packets go one by one, so the PMT
+	// PIDs are known before the packets after a PAT are assembled. With
+	// statistics enabled, runs of packets of one kind are timed.
+	TS_BOOL ProcessPackets(unsigned char* data, unsigned length) {
+		for (std::size_t i = 0; i < taps_.size(); ++i)
+			taps_[i].first(taps_[i].second, data, length);
+
+		ParserStatistics* statistics = statistics_enabled_.load(std::memory_order_relaxed) ? statistics_.get() : 0;
+		if (!statistics) {
+			if (attribute_ || assemble_ || ebu_filter_)
+				return ProcessSplit(data, length, 0);
+			return Process(data, length);
+		}
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		statistics->CountPackets(data, length);
+		const TS_BOOL result = ProcessSplit(data, length, statistics);
+		Bump(statistics->bytes, length);
+		Bump(statistics->process_nanoseconds, Nanoseconds(start));
+		return result;
+	}
+
+	TS_VOID AssemblePacket(const unsigned char* packet, unsigned pid) {
+		assembler_.Feed(packet, pid, [this](unsigned section_pid, const unsigned char* section, unsigned section_length) {
+			OnSection(section_pid, section, section_length);
+		});
+	}
+
+	// queues the header for the table event the section will trigger
+	TS_VOID OnSection(unsigned pid, const unsigned char* section, unsigned length) {
+		if (attribute_) {
+			SectionHeader header;
+			header.table_id = section[0];
+			if ((section[1] & 0x80) && length >= 8) {
+				header.table_id_extension = (section[3] << 8) | section[4];
+				header.version = (section[5] >> 1) & 0x1F;
+			}
+			else {
+				header.table_id_extension = -1;
+				header.version = -1;
+			}
+			completed_.push_back(header);
+		}
+		if (recorder_)
+			recorder_->Store(pid, section, length);
+		for (std::size_t i = 0; i < section_observers_.size(); ++i)
+			section_observers_[i].first(section_observers_[i].second, pid, section, length);
+	}
+
+	// Hands the packets of wanted PIDs on. Headers are one packet apart, so
+	// the scan is a table lookup per packet; lost sync is searched with
+	// memchr. Bytes that cannot be judged yet are carried over to the next
+	// call.
+	TS_BOOL Prescan(unsigned char* data, unsigned length) {
+		unsigned long long filtered = 0;
+		unsigned position = 0;
+		TS_BOOL result = 1;
+
+		if (!carry_.empty()) {
+			// packets starting in the carried bytes, with enough new data to
+			// confirm a resync
+			const unsigned carried = static_cast<unsigned>(carry_.size());
+			const unsigned taken = std::min(length, 2 * packet_size_);
+			carry_.insert(carry_.end(), data, data + taken);
+			const unsigned stop = Scan(&carry_[0], carried + taken, 0, carried, filtered, result);
+			if (stop < carried) {
+				carry_.erase(carry_.begin(), carry_.begin() + stop);
+				position = length;
+			}
+			else {
+				carry_.clear();
+				position = stop - carried;
+			}
+		}
+
+		const unsigned stop = Scan(data, length, position, length, filtered, result);
+		if (stop < length)
+			carry_.assign(data + stop, data + length);
+		if (filtered)
+			Bump(filtered_packets_, filtered);
+		return result;
+	}
+
+	// Passes the wanted packets starting in [position, limit) on: 188 byte
+	// packets in place as contiguous runs, 192 and 204 byte packets cut to
+	// 188 bytes and gathered in batches. Returns where it stopped, early at
+	// a resync that cannot be confirmed within length.
+	unsigned Scan(unsigned char* data, unsigned length, unsigned position, unsigned limit, unsigned long long& filtered, TS_BOOL& result) {
+		const unsigned size = packet_size_;
+		const unsigned sync = size == 192 ? 4 : 0;
+		unsigned run = position, run_end = position;
+		while (position < limit && position + size <= length) {
+			if (!synced_) {
+				position = Resync(data, position, length);
+				if (position + size + sync >= length)
+					break;
+				synced_ = true;
+				continue;
+			}
+			unsigned char* packet = data + position + sync;
+			if (packet[0] != 0x47) {
+				Bump(resyncs_, 1);
+				synced_ = false;
+				++position;
+				continue;
+			}
+			if (!pid_pass_[((packet[1] & 0x1F) << 8) | packet[2]]) {
+				++filtered;
+			}
+			else if (size == 188) {
+				if (position != run_end) {
+					if (run_end > run)
+						result = ProcessPackets(data + run, run_end - run) && result;
+					run = position;
+				}
+				run_end = position + 188;
+			}
+			else {
+				gather_.insert(gather_.end(), packet, packet + 188);
+				if (gather_.size() >= PRESCAN_BATCH * 188)
+					result = ProcessGathered() && result;
+			}
+			position += size;
+		}
+		if (run_end > run)
+			result = ProcessPackets(data + run, run_end - run) && result;
+		if (!gather_.empty())
+			result = ProcessGathered() && result;
+		return position;
+	}
+
+	TS_BOOL ProcessGathered() {
+		const TS_BOOL result = ProcessPackets(&gather_[0], static_cast<unsigned>(gather_.size()));
+		gather_.clear();
+		return result;
+	}
+
+	// first packet start at or after position whose sync byte is followed by
+	// another one a packet later, or one whose successor is beyond length
+	unsigned Resync(const unsigned char* data, unsigned position, unsigned length) {
+		const unsigned size = packet_size_;
+		const unsigned sync = size == 192 ? 4 : 0;
+		while (position + sync < length) {
+			const void* found = std::memchr(data + position + sync, 0x47, length - position - sync);
+			if (!found)
+				break;
+			position = static_cast<unsigned>(static_cast<const unsigned char*>(found) - data) - sync;
+			if (position + size + sync >= length || data[position + size + sync] == 0x47)
+				return position;
+			++position;
+		}
+		// keep a tail that may still start a packet
+		return std::max(position, length - std::min(length, sync));
+	}
+
+	// Hands runs of packets to libtssi in one call: uninteresting packets,
+	// and with statistics packets of one kind, so a run costs one clock
+	// read. Packets whose table events are attributed, PAT packets while
+	// sections are assembled and filtered teletext packets go one by one.
+	TS_BOOL ProcessSplit(unsigned char* data, unsigned length, ParserStatistics* statistics) {
+		if (length < 188 || data[0] != 0x47)
+			return TimedProcess(data, length, KIND_OTHER, statistics);
+
+		TS_BOOL result = 1;
+		unsigned run = 0;
+		unsigned char run_kind = KIND_OTHER;
+		unsigned position = 0;
+		for (; position + 188 <= length; position += 188) {
+			const unsigned char* packet = data + position;
+			if (packet[0] != 0x47)
+				break;
+			const unsigned pid = ((packet[1] & 0x1F) << 8) | packet[2];
+			const unsigned char kind = pid_kinds_[pid];
+			const bool section = IsSectionKind(kind);
+			const bool single = (section && attribute_) || (kind == KIND_PAT && assemble_) || (kind == KIND_EBU && ebu_filter_);
+			const unsigned char timed = statistics && kind != KIND_NONE ? kind : static_cast<unsigned char>(KIND_OTHER);
+
+			if (!single && timed == run_kind) {
+				if (section && assemble_)
+					AssemblePacket(packet, pid);
+				continue;
+			}
+			if (position > run)
+				result = TimedProcess(data + run, position - run, run_kind, statistics) && result;
+			run = position;
+			if (section && assemble_)
+				AssemblePacket(packet, pid);
+			if (!single) {
+				run_kind = timed;
+				continue;
+			}
+
+			current_pid_ = static_cast<int>(pid);
+			if (kind == KIND_EBU && ebu_filter_)
+				result = TimedProcess(FilterTeletext(packet), 188, kind, statistics) && result;
+			else
+				result = TimedProcess(data + position, 188, kind, statistics) && result;
+			current_pid_ = -1;
+			completed_.clear();
+			run = position + 188;
+			run_kind = KIND_OTHER;
+		}
+		if (position > run)
+			result = TimedProcess(data + run, position - run, run_kind, statistics) && result;
+		if (length > position)
+			result = TimedProcess(data + position, length - position, KIND_OTHER, statistics) && result;
+		return result;
+	}
+
+	TS_BOOL TimedProcess(unsigned char* data, unsigned length, unsigned char kind, ParserStatistics* statistics) {
+		if (!statistics)
+			return Process(data, length);
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		const TS_BOOL result = Process(data, length);
+		Bump(statistics->kind_nanoseconds[kind], Nanoseconds(start));
+		return result;
+	}
+
+	// attribution is only worth the per-packet calls if someone looks at
+	// table events
+	TS_VOID UpdateAttribution() {
+		bool attribute = false;
+		for (int i = 0; i < TABLE_SOURCES; ++i)
+			attribute = attribute || slots_[i].queued.load() || !slots_[i].observers.empty();
+		attribute_ = attribute;
+		UpdateAssembly();
+	}
+
+	TS_VOID UpdateAssembly() {
+		const bool assemble = attribute_ || recorder_ || !section_observers_.empty();
+		if (assemble && !assemble_)
+			assembler_.Clear();
+		assemble_ = assemble;
+	}
+
+	TS_VOID ResetSectionState() {
+		RebuildPidKinds();
+		std::fill(ebu_keep_, ebu_keep_ + 8, false);
+		teletext_fingerprints_.clear();
+	}
+
+	// Fixed SI PIDs, PMT and network PIDs of the current PAT, then the
+	// configured PIDs. Rebuilt as a whole, so PIDs that moved or left the
+	// PAT lose their kind.
+	TS_VOID RebuildPidKinds() {
+		std::fill(pid_kinds_.begin(), pid_kinds_.end(), static_cast<unsigned char>(KIND_NONE));
+		pid_kinds_[0x00] = KIND_PAT;
+		pid_kinds_[0x10] = KIND_NIT;
+		pid_kinds_[0x11] = KIND_SDT;
+		pid_kinds_[0x12] = KIND_EIT;
+		pid_kinds_[0x14] = KIND_TDT;
+		tssi::Table_Pat& pat = TablePat();
+		const unsigned network_pid = pat.GetNetworkPid() & 0x1FFF;
+		if (network_pid != 0x00)
+			pid_kinds_[network_pid] = KIND_NIT;
+		for (unsigned i = 0; i < pat.GetProgramListLength(); ++i)
+			pid_kinds_[pat.GetProgramMapPid(i) & 0x1FFF] = KIND_PMT;
+		if (pid_ait_ >= 0)
+			pid_kinds_[pid_ait_ & 0x1FFF] = KIND_AIT;
+		if (pid_dsmcc_ >= 0)
+			pid_kinds_[pid_dsmcc_ & 0x1FFF] = KIND_DSMCC;
+		if (pid_ebu_ >= 0)
+			pid_kinds_[pid_ebu_ & 0x1FFF] = KIND_EBU;
+	}
+
+	// Hamming 8/4 data bits of a byte sent LSB first, without correction
+	static unsigned HammingNibble(unsigned char value) {
+		return ((value >> 6) & 1) | ((value >> 3) & 2) | (value & 4) | ((value << 3) & 8);
+	}
+
+	// Copy of a teletext packet with the data units of unselected pages
+	// replaced by stuffing. Data units are 46 bytes and aligned to the TS
+	// payload (EN 300 472); anything else is passed on unchanged.
+	unsigned char* FilterTeletext(const unsigned char* packet) {
+		std::memcpy(teletext_packet_, packet, 188);
+		if (!(packet[3] & 0x10))
+			return teletext_packet_;
+		unsigned offset = 4;
+		if (packet[3] & 0x20)
+			offset += 1 + packet[4];
+		if (packet[1] & 0x40) {
+			if (offset + 9 > 188)
+				return teletext_packet_;
+			offset += 9 + packet[offset + 8] + 1;    // PES header, data_identifier
+		}
+
+		while (offset + 2 <= 188) {
+			unsigned char* unit = teletext_packet_ + offset;
+			if (offset + 2 + unit[1] > 188)
+				break;
+			if ((unit[0] == 0x02 || unit[0] == 0x03) && unit[1] == 44)
+				FilterDataUnit(unit);
+			offset += 2 + unit[1];
+		}
+		return teletext_packet_;
+	}
+
+	TS_VOID FilterDataUnit(unsigned char* unit) {
+		const unsigned address = HammingNibble(unit[4]);
+		const unsigned magazine = address & 7;
+		const unsigned row = (address >> 3) | (HammingNibble(unit[5]) << 1);
+		if (row == 0) {
+			const unsigned page = HammingNibble(unit[7]) << 4 | HammingNibble(unit[6]);
+			const bool subtitle = (HammingNibble(unit[11]) & 0x08) != 0;    // C6
+			ebu_keep_[magazine] = ebu_pages_[magazine * 256 + page] || (ebu_subtitles_ && subtitle);
+			if (!ebu_keep_[magazine])
+				unit[6] = unit[7] = 0x57;    // Hamming 0xF
+		}
+		else if (row <= 28 && !ebu_keep_[magazine]) {
+			unit[0] = 0xFF;
+		}
+	}
+
+	static TS_VOID Dispatch(TS_PVOID data) {
+		CallbackSlot* slot = reinterpret_cast<CallbackSlot*>(data);
+		slot->parser->Dispatch(*slot);
+	}
+
+	TS_VOID Dispatch(CallbackSlot& slot) {
+		ParserStatistics* statistics = statistics_enabled_.load(std::memory_order_relaxed) ? statistics_.get() : 0;
+		if (!statistics) {
+			DispatchEvent(slot);
+			return;
+		}
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		DispatchEvent(slot);
+		Bump(statistics->callbacks, 1);
+		Bump(statistics->callback_nanoseconds, Nanoseconds(start));
+	}
+
+	TS_VOID DispatchEvent(CallbackSlot& slot) {
+		ParserEvent event;
+		event.source = slot.source;
+		event.pid = -1;
+		event.table_id = -1;
+		event.table_id_extension = -1;
+		event.version = -1;
+		event.value = 0;
+		Bump(updates_[slot.source], 1);
+
+		if (slot.source == SOURCE_PCR) {
+			event.pid = pid_pcr_;
+			event.value = static_cast<unsigned long long>(PacketPcr().GetPcr());
+		}
+		else if (slot.source == SOURCE_EBU) {
+			event.pid = pid_ebu_;
+		}
+		else if (current_pid_ >= 0) {
+			event.pid = current_pid_;
+			// the first section of the packet that belongs to the table
+			for (std::size_t i = 0; i < completed_.size(); ++i) {
+				const SectionHeader& header = completed_[i];
+				if (!IsSourceTable(slot.source, header.table_id))
+					continue;
+				event.table_id = header.table_id;
+				event.table_id_extension = header.table_id_extension;
+				event.version = header.version;
+				completed_.erase(completed_.begin(), completed_.begin() + i + 1);
+				break;
+			}
+		}
+
+		if (slot.source == SOURCE_PAT)
+			RebuildPidKinds();
+
+		for (std::size_t i = 0; i < slot.observers.size(); ++i)
+			slot.observers[i].first(slot.observers[i].second, event);
+
+		if (slot.queued.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(events_mutex_);
+			events_.push_back(event);
+		}
+		else if (slot.immediate.load(std::memory_order_relaxed)) {
+			PyGILState_STATE state = PyGILState_Ensure();
+			// exceptions must not unwind through libtssi
+			try {
+				if (!slot.callback.is_none())
+					call<void>(slot.callback.ptr());
+			}
+			catch (const error_already_set&) {
+				PyErr_Print();
+			}
+			PyGILState_Release(state);
+		}
+	}
+
+	std::recursive_mutex processing_mutex_;
+	CallbackSlot slots_[SOURCE_COUNT];
+	int current_pid_;
+	bool attribute_;
+	bool assemble_;
+	SectionAssembler assembler_;
+	std::vector<SectionHeader> completed_;    // sections completed by the current packet
+	std::vector<std::pair<SectionObserver, TS_PVOID> > section_observers_;
+	std::vector<unsigned char> pid_kinds_;
+	int pid_ait_;
+	int pid_dsmcc_;
+	int pid_ebu_;
+	int pid_pcr_;
+	std::vector<std::pair<PacketTap, TS_PVOID> > taps_;
+
+	bool ebu_filter_;
+	bool ebu_subtitles_;
+	std::vector<bool> ebu_pages_;    // magazine * 256 + page
+	bool ebu_keep_[8];
+	unsigned char teletext_packet_[188];
+
+	bool prescan_;
+	bool pid_filter_;
+	unsigned packet_size_;
+	bool synced_;
+	std::vector<unsigned char> pid_pass_;
+	std::vector<unsigned char> gather_;      // at most PRESCAN_BATCH packets
+	std::vector<unsigned char> carry_;
+	Counter filtered_packets_;
+	Counter resyncs_;
+	std::unique_ptr<SectionRecorder> recorder_;
+
+	std::unique_ptr<ParserStatistics> statistics_;
+	std::atomic<bool> statistics_enabled_;
+
+	Counter updates_[SOURCE_COUNT];
+	std::unique_ptr<TableIndex> index_;
+	unsigned long long teletext_seen_;
+	std::unordered_map<unsigned, unsigned long long> teletext_fingerprints_;
+
+	std::mutex events_mutex_;
+	std::vector<ParserEvent> events_;
+	object event_callback_;
+};
+
+// callback wrappers
+//
+// The callback objects are kept by the owning PythonParser for its whole
+// lifetime; None removes a callback.
+
+// slot of a table or packet object, ValueError if it has no parser
+CallbackSlot& FindCallbackSlot(const void* owner);
+
+TS_VOID SetEbuCallback(tssi::Packet_Ebu& self, object py_callback);
+TS_VOID SetPcrCallback(tssi::Packet_Pcr& self, object py_callback);
+
+template<class T> TS_VOID SetTableCallback(T& self, object py_callback) {
+	CallbackSlot& slot = FindCallbackSlot(&self);
+	slot.parser->SetCallback(slot.source, py_callback);
+}
+
+// pages: teletext page numbers to keep, see PythonParser::SetEbuFilter
+TS_VOID ParserSetPidEbu(PythonParser& self, TS_WORD pid, bool subtitles_only, object py_pages);
+
+#endif // __TSSIPYTHON_PARSER_H_INCLUDED__
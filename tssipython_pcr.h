@@ -0,0 +1,460 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_PCR_H_INCLUDED__
+#define __TSSIPYTHON_PCR_H_INCLUDED__
+
+#include "tssipython_parser.h"
+
+// PCR timing
+//
+// A tap on the parser follows the PCR PIDs of all programs in the PMT. The
+// programs are reread when the parser's PAT or PMT update count moved, so
+// the monitor needs no table observers, which would send SI packets through
+// the parser one by one. Each PCR is compared with the value expected from
+// the PCR before it, the bytes in between and the rate that PID measured
+// over the previous slice; the difference is reported as jitter.
+//
+// The PCR PID of the first program is the reference clock. Every packet is
+// stamped with that clock, interpolated from the last reference PCR at the
+// rate of the last reference interval, so slices of window / slices seconds
+// close at the packet crossing their end. Python reads aggregates over the
+// last slices, a window sliding by one slice at a time. A discontinuity on
+// the reference PID discards the open slice, its span cannot be timed.
+
+static const unsigned long long PCR_MODULUS = (1ULL << 33) * 300;
+static const unsigned long long PCR_HZ = 27000000;
+static const unsigned long long PCR_MAX_INTERVAL = PCR_HZ * 40 / 1000;       // ETR 290 repetition
+static const unsigned long long PCR_MAX_DISCONTINUITY = PCR_HZ / 10;         // ETR 290 discontinuity
+
+class PcrMonitor : boost::noncopyable {
+public:
+	PcrMonitor(object parser, double window, unsigned slices)
+		: parser_object_(parser), parser_(extract<PythonParser&>(parser)),
+		  slice_count_(slices ? slices : 1),
+		  slice_ticks_(static_cast<unsigned long long>((window > 0.001 ? window : 0.001) * PCR_HZ / slice_count_)),
+		  program_updates_(~0ULL), position_(0), reference_pid_(-1),
+		  clock_valid_(false), clock_(0), clock_position_(0), bytes_per_tick_(0), slice_end_(0),
+		  slice_packets_(8192, 0), slice_total_(0), pcr_index_(8192, -1),
+		  reset_(false), clock_seconds_(-1), discarded_(0) {
+		RefuseFilter();
+		ScopedGILRelease nogil;
+		parser_.AddTap(&PacketTap, this);
+	}
+
+	~PcrMonitor() {
+		ScopedGILRelease nogil;
+		parser_.RemoveTap(&PacketTap, this);
+	}
+
+	// Aggregates of the last slices. Bitrates in bit/s, times in
+	// nanoseconds (jitter) and milliseconds (intervals).
+	dict Snapshot() {
+		RefuseFilter();
+		std::deque<Slice> slices;
+		{
+			std::lock_guard<std::mutex> lock(slices_mutex_);
+			slices = slices_;
+		}
+
+		dict result;
+		double seconds = 0;
+		unsigned long long packets = 0;
+		std::map<unsigned, unsigned long long> pid_packets;
+		std::map<unsigned, PcrTotals> pcrs;
+		for (std::size_t i = 0; i < slices.size(); ++i) {
+			const Slice& slice = slices[i];
+			seconds += slice.seconds;
+			packets += slice.packets;
+			for (std::size_t j = 0; j < slice.pid_packets.size(); ++j)
+				pid_packets[slice.pid_packets[j].first] += slice.pid_packets[j].second;
+			for (std::size_t j = 0; j < slice.pcrs.size(); ++j)
+				pcrs[slice.pcrs[j].pid].Add(slice.pcrs[j]);
+		}
+		const double clock = clock_seconds_.load(std::memory_order_relaxed);
+		result["slices"] = slices.size();
+		result["seconds"] = seconds;
+		result["clock"] = clock < 0 ? object() : object(clock);
+		result["discarded"] = discarded_.load(std::memory_order_relaxed);
+		result["bitrate"] = seconds > 0 ? packets * 1504 / seconds : 0.0;
+
+		dict pids;
+		for (std::map<unsigned, unsigned long long>::const_iterator it = pid_packets.begin(); it != pid_packets.end(); ++it)
+			pids[it->first] = seconds > 0 ? it->second * 1504 / seconds : 0.0;
+		result["pids"] = pids;
+
+		dict programs;
+		if (!slices.empty()) {
+			const std::vector<Program>& latest = slices.back().programs;
+			for (std::size_t i = 0; i < latest.size(); ++i) {
+				const Program& program = latest[i];
+				unsigned long long program_packets = 0;
+				for (std::size_t j = 0; j < program.pids.size(); ++j) {
+					std::map<unsigned, unsigned long long>::const_iterator it = pid_packets.find(program.pids[j]);
+					if (it != pid_packets.end())
+						program_packets += it->second;
+				}
+				dict entry;
+				entry["pcr_pid"] = program.pcr_pid;
+				entry["bitrate"] = seconds > 0 ? program_packets * 1504 / seconds : 0.0;
+				std::map<unsigned, PcrTotals>::const_iterator pcr = pcrs.find(program.pcr_pid);
+				entry["pcr"] = pcr == pcrs.end() ? object() : object(pcr->second.ToDict());
+				programs[program.number] = entry;
+			}
+		}
+		result["programs"] = programs;
+		return result;
+	}
+
+	// Drops all slices and PCR references. The parsing thread applies it
+	// before its next buffer, so it is safe while the parser is running.
+	void Reset() {
+		reset_.store(true);
+		clock_seconds_.store(-1, std::memory_order_relaxed);
+		discarded_.store(0, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(slices_mutex_);
+		slices_.clear();
+	}
+
+private:
+	struct Program {
+		unsigned number;
+		unsigned pcr_pid;
+		std::vector<unsigned> pids;    // PMT, PCR and elementary streams
+	};
+
+	// slice statistics of one PCR PID
+	struct PcrWindow {
+		unsigned pid;
+		unsigned long long pcrs;
+		unsigned long long discontinuities;            // not signalled
+		unsigned long long signalled_discontinuities;
+		unsigned long long interval_errors;
+		unsigned long long max_interval;               // ticks
+		unsigned long long ticks;                      // continuous PCR time
+		unsigned long long bytes;                      // over the same spans
+		double jitter_max;                             // ticks
+		double jitter_squares;
+		unsigned long long jitter_samples;
+
+		// drops the measured spans, keeps the counts
+		TS_VOID ClearSpans() {
+			max_interval = 0;
+			ticks = 0;
+			bytes = 0;
+			jitter_max = 0;
+			jitter_squares = 0;
+			jitter_samples = 0;
+		}
+	};
+
+	struct PcrState {
+		explicit PcrState(unsigned pcr_pid) : valid(false), last_pcr(0), last_position(0), bits_per_tick(0) {
+			std::memset(&window, 0, sizeof(window));
+			window.pid = pcr_pid;
+			pid = pcr_pid;
+		}
+
+		unsigned pid;
+		bool valid;
+		unsigned long long last_pcr;
+		unsigned long long last_position;    // bytes
+		double bits_per_tick;                // previous slice, 0: unknown
+		PcrWindow window;
+	};
+
+	struct PcrTotals {
+		PcrTotals() { std::memset(&totals, 0, sizeof(totals)); }
+
+		void Add(const PcrWindow& window) {
+			totals.pcrs += window.pcrs;
+			totals.discontinuities += window.discontinuities;
+			totals.signalled_discontinuities += window.signalled_discontinuities;
+			totals.interval_errors += window.interval_errors;
+			totals.max_interval = std::max(totals.max_interval, window.max_interval);
+			totals.ticks += window.ticks;
+			totals.bytes += window.bytes;
+			totals.jitter_max = std::max(totals.jitter_max, window.jitter_max);
+			totals.jitter_squares += window.jitter_squares;
+			totals.jitter_samples += window.jitter_samples;
+		}
+
+		dict ToDict() const {
+			dict result;
+			result["pcrs"] = totals.pcrs;
+			result["discontinuities"] = totals.discontinuities;
+			result["signalled_discontinuities"] = totals.signalled_discontinuities;
+			result["interval_errors"] = totals.interval_errors;
+			result["max_interval_ms"] = totals.max_interval * 1000.0 / PCR_HZ;
+			result["bitrate"] = totals.ticks ? totals.bytes * 8.0 * PCR_HZ / totals.ticks : 0.0;
+			result["jitter_max_ns"] = totals.jitter_max * 1e9 / PCR_HZ;
+			result["jitter_rms_ns"] = totals.jitter_samples ? std::sqrt(totals.jitter_squares / totals.jitter_samples) * 1e9 / PCR_HZ : 0.0;
+			return result;
+		}
+
+		PcrWindow totals;
+	};
+
+	struct Slice {
+		double seconds;
+		unsigned long long packets;
+		std::vector<std::pair<unsigned, unsigned long long> > pid_packets;
+		std::vector<PcrWindow> pcrs;
+		std::vector<Program> programs;
+	};
+
+	// with a PID filter the tap misses packets, bitrates would be wrong
+	TS_VOID RefuseFilter() {
+		if (parser_.HasPidFilter()) {
+			PyErr_SetString(PyExc_RuntimeError, "PcrMonitor needs the whole stream, the parser has a PID filter");
+			throw_error_already_set();
+		}
+	}
+
+	static TS_VOID PacketTap(TS_PVOID context, const unsigned char* data, unsigned length) {
+		reinterpret_cast<PcrMonitor*>(context)->Tap(data, length);
+	}
+
+	// Buffers need not start on a packet; bytes up to the next sync byte
+	// are skipped, but still move the stream position on.
+	TS_VOID Tap(const unsigned char* data, unsigned length) {
+		if (reset_.exchange(false))
+			Clear();
+		const unsigned long long program_updates = parser_.Updates(SOURCE_PAT) + parser_.Updates(SOURCE_PMT);
+		if (program_updates != program_updates_) {
+			program_updates_ = program_updates;
+			UpdatePrograms();
+		}
+
+		const unsigned long long start = position_;
+		unsigned position = 0;
+		while (position + 188 <= length) {
+			const unsigned char* packet = data + position;
+			if (packet[0] != 0x47 || (position + 376 <= length && packet[188] != 0x47)) {
+				++position;
+				continue;
+			}
+			position_ = start + position;
+			if (clock_valid_ && bytes_per_tick_ > 0) {
+				const unsigned long long now = Now();
+				while (now >= slice_end_)
+					CloseSlice();
+			}
+
+			const unsigned pid = ((packet[1] & 0x1F) << 8) | packet[2];
+			++slice_packets_[pid];
+			++slice_total_;
+			const int index = pcr_index_[pid];
+			if (index >= 0 && (packet[3] & 0x20) && packet[4] >= 7 && (packet[5] & 0x10)) {
+				const unsigned long long ticks = Pcr(pcr_states_[index], packet);
+				if (static_cast<int>(pcr_states_[index].pid) == reference_pid_)
+					Reference(ticks);
+			}
+			position += 188;
+		}
+		position_ = start + length;
+		if (clock_valid_)
+			clock_seconds_.store(static_cast<double>(bytes_per_tick_ > 0 ? Now() : clock_) / PCR_HZ, std::memory_order_relaxed);
+	}
+
+	// reference clock at position_, at most a discontinuity past the last PCR
+	unsigned long long Now() const {
+		const double ticks = (position_ - clock_position_) / bytes_per_tick_;
+		return clock_ + (ticks < PCR_MAX_DISCONTINUITY ? static_cast<unsigned long long>(ticks) : PCR_MAX_DISCONTINUITY);
+	}
+
+	// Updates the PCR statistics of a PID; returns the ticks since its last
+	// PCR, or 0 if there is no continuous interval.
+	unsigned long long Pcr(PcrState& state, const unsigned char* packet) {
+		const unsigned long long base = static_cast<unsigned long long>(packet[6]) << 25 | packet[7] << 17 | packet[8] << 9 | packet[9] << 1 | packet[10] >> 7;
+		const unsigned long long pcr = base * 300 + ((packet[10] & 0x01) << 8 | packet[11]);
+		PcrWindow& window = state.window;
+		++window.pcrs;
+
+		unsigned long long result = 0;
+		if (packet[5] & 0x80) {
+			++window.signalled_discontinuities;
+			state.valid = false;
+		}
+		if (state.valid) {
+			const unsigned long long ticks = (pcr + PCR_MODULUS - state.last_pcr) % PCR_MODULUS;
+			const unsigned long long bytes = position_ - state.last_position;
+			if (ticks == 0 || ticks > PCR_MAX_DISCONTINUITY) {
+				++window.discontinuities;
+			}
+			else {
+				if (ticks > PCR_MAX_INTERVAL)
+					++window.interval_errors;
+				window.max_interval = std::max(window.max_interval, ticks);
+				window.ticks += ticks;
+				window.bytes += bytes;
+				if (state.bits_per_tick > 0) {
+					const double jitter = static_cast<double>(ticks) - bytes * 8 / state.bits_per_tick;
+					window.jitter_max = std::max(window.jitter_max, std::fabs(jitter));
+					window.jitter_squares += jitter * jitter;
+					++window.jitter_samples;
+				}
+				result = ticks;
+			}
+		}
+		state.valid = true;
+		state.last_pcr = pcr;
+		state.last_position = position_;
+		return result;
+	}
+
+	// Moves the reference clock to a PCR. Without a continuous interval the
+	// clock stays where it was and the open slice starts over from here.
+	TS_VOID Reference(unsigned long long ticks) {
+		if (!ticks) {
+			if (clock_valid_)
+				Bump(discarded_, 1);
+			DiscardSlice();
+			clock_valid_ = true;
+			clock_position_ = position_;
+			slice_end_ = clock_ + slice_ticks_;
+			return;
+		}
+		bytes_per_tick_ = static_cast<double>(position_ - clock_position_) / ticks;
+		clock_ += ticks;
+		clock_position_ = position_;
+		while (clock_ >= slice_end_)
+			CloseSlice();
+	}
+
+	// the packets before the current one; counts of PCR events are kept
+	TS_VOID DiscardSlice() {
+		std::fill(slice_packets_.begin(), slice_packets_.end(), 0);
+		slice_total_ = 0;
+		for (std::size_t i = 0; i < pcr_states_.size(); ++i)
+			pcr_states_[i].window.ClearSpans();
+	}
+
+	// hands the slice ending at slice_end_ to Python
+	TS_VOID CloseSlice() {
+		Slice slice;
+		slice.seconds = static_cast<double>(slice_ticks_) / PCR_HZ;
+		slice.packets = slice_total_;
+		for (unsigned pid = 0; pid < 8192; ++pid)
+			if (slice_packets_[pid])
+				slice.pid_packets.push_back(std::make_pair(pid, slice_packets_[pid]));
+		for (std::size_t i = 0; i < pcr_states_.size(); ++i) {
+			PcrState& state = pcr_states_[i];
+			slice.pcrs.push_back(state.window);
+			if (state.window.ticks)
+				state.bits_per_tick = state.window.bytes * 8.0 / state.window.ticks;
+			std::memset(&state.window, 0, sizeof(state.window));
+			state.window.pid = state.pid;
+		}
+		slice.programs = programs_;
+
+		std::fill(slice_packets_.begin(), slice_packets_.end(), 0);
+		slice_total_ = 0;
+		slice_end_ += slice_ticks_;
+
+		std::lock_guard<std::mutex> lock(slices_mutex_);
+		slices_.push_back(slice);
+		while (slices_.size() > slice_count_)
+			slices_.pop_front();
+	}
+
+	// applies Reset on the parsing thread
+	TS_VOID Clear() {
+		for (std::size_t i = 0; i < pcr_states_.size(); ++i)
+			pcr_states_[i] = PcrState(pcr_states_[i].pid);
+		std::fill(slice_packets_.begin(), slice_packets_.end(), 0);
+		slice_total_ = 0;
+		clock_valid_ = false;
+		clock_ = 0;
+		bytes_per_tick_ = 0;
+		clock_seconds_.store(-1, std::memory_order_relaxed);
+		discarded_.store(0, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(slices_mutex_);
+		slices_.clear();
+	}
+
+	// programs from PAT and PMT; PCR state survives for PIDs kept
+	TS_VOID UpdatePrograms() {
+		tssi::Table_Pat& pat = parser_.TablePat();
+		tssi::Table_Pmt& pmt = parser_.TablePmt();
+		programs_.clear();
+		for (unsigned i = 0; i < pmt.GetProgramListLength(); ++i) {
+			Program program;
+			program.number = pmt.GetProgramNumber(i);
+			program.pcr_pid = pmt.GetPcrPid(static_cast<TS_WORD>(program.number)) & 0x1FFF;
+			for (unsigned j = 0; j < pat.GetProgramListLength(); ++j)
+				if (pat.GetProgramNumber(j) == program.number)
+					program.pids.push_back(pat.GetProgramMapPid(j) & 0x1FFF);
+			program.pids.push_back(program.pcr_pid);
+			for (unsigned j = 0; j < pmt.GetEsListLength(static_cast<TS_WORD>(program.number)); ++j)
+				program.pids.push_back(pmt.GetEsPid(static_cast<TS_WORD>(program.number), j) & 0x1FFF);
+			std::sort(program.pids.begin(), program.pids.end());
+			program.pids.erase(std::unique(program.pids.begin(), program.pids.end()), program.pids.end());
+			programs_.push_back(program);
+		}
+
+		std::vector<PcrState> states;
+		std::vector<int> index(8192, -1);
+		for (std::size_t i = 0; i < programs_.size(); ++i) {
+			const unsigned pid = programs_[i].pcr_pid;
+			if (pid == 0x1FFF || index[pid] >= 0)
+				continue;
+			index[pid] = static_cast<int>(states.size());
+			states.push_back(pcr_index_[pid] >= 0 ? pcr_states_[pcr_index_[pid]] : PcrState(pid));
+		}
+		pcr_states_.swap(states);
+		pcr_index_.swap(index);
+		if (reference_pid_ < 0 || pcr_index_[reference_pid_] < 0) {
+			// a new reference starts the clock over
+			reference_pid_ = pcr_states_.empty() ? -1 : static_cast<int>(pcr_states_[0].pid);
+			clock_valid_ = false;
+			bytes_per_tick_ = 0;
+		}
+	}
+
+	object parser_object_;
+	PythonParser& parser_;
+	const std::size_t slice_count_;
+	const unsigned long long slice_ticks_;
+
+	// parsing thread only
+	unsigned long long program_updates_;     // PAT and PMT updates programs_ was read at
+	std::vector<Program> programs_;
+	unsigned long long position_;            // bytes
+	int reference_pid_;
+	bool clock_valid_;
+	unsigned long long clock_;               // continuous ticks at the last reference PCR
+	unsigned long long clock_position_;
+	double bytes_per_tick_;                  // last reference interval, 0: unknown
+	unsigned long long slice_end_;
+	std::vector<unsigned long long> slice_packets_;
+	unsigned long long slice_total_;
+	std::vector<int> pcr_index_;
+	std::vector<PcrState> pcr_states_;
+
+	std::atomic<bool> reset_;
+	std::atomic<double> clock_seconds_;      // -1: no reference PCR yet
+	Counter discarded_;
+	std::mutex slices_mutex_;
+	std::deque<Slice> slices_;
+};
+
+#endif // __TSSIPYTHON_PCR_H_INCLUDED__
@@ -0,0 +1,349 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_PIPELINE_H_INCLUDED__
+#define __TSSIPYTHON_PIPELINE_H_INCLUDED__
+
+#include "tssipython_parser.h"
+
+// background capture pipeline
+//
+// A reader thread fills a single producer / single consumer ring of TS
+// packets from a descriptor, a parser thread drains it into the wrapped
+// tssi::Parser. Python only polls table notifications and statistics.
+class CapturePipeline : boost::noncopyable {
+public:
+	CapturePipeline(object parser, unsigned ring_packets, bool block)
+		: parser_object_(parser), parser_(extract<PythonParser&>(parser)),
+		  capacity_(ring_packets < 16 ? 16 : ring_packets), ring_(capacity_ * 188),
+		  block_(block), fd_(-1), owns_fd_(false), error_(0), acquired_(false),
+		  head_(0), tail_(0), stop_(false), eof_(false), finished_(true),
+		  packets_processed_(0), bytes_read_(0), overruns_(0), high_water_(0) {
+		ScopedGILRelease nogil;
+		for (int i = 0; i < TABLE_SOURCES; ++i)
+			parser_.AddObserver(static_cast<EventSource>(i), &TableObserver, this);
+	}
+
+	~CapturePipeline() {
+		ScopedGILRelease nogil;
+		Shutdown();
+		for (int i = 0; i < TABLE_SOURCES; ++i)
+			parser_.RemoveObserver(static_cast<EventSource>(i), &TableObserver, this);
+	}
+
+	void Start(object py_fd) {
+		const int fd = PyObject_AsFileDescriptor(py_fd.ptr());
+		if (fd < 0)
+			throw_error_already_set();
+		Launch(fd, false);
+	}
+
+	void StartFile(std::string path) {
+		const int fd = TSSIPY_OPEN(path.c_str(), TSSIPY_OPEN_FLAGS);
+		if (fd < 0)
+			RaiseIOError(path);
+		Launch(fd, true);
+	}
+
+	// stops reading, packets left in the ring are discarded
+	void Stop() {
+		{
+			ScopedGILRelease nogil;
+			Shutdown();
+		}
+		RaiseReaderError();
+	}
+
+	// waits until the source is exhausted and the ring is drained;
+	// returns false if the timeout (seconds, negative: none) expired
+	bool Wait(double timeout) {
+		{
+			ScopedGILRelease nogil;
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<long long>(timeout * 1e6));
+			while (!finished_.load(std::memory_order_acquire)) {
+				if (timeout >= 0 && std::chrono::steady_clock::now() >= deadline)
+					break;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			if (!finished_.load(std::memory_order_acquire))
+				return false;
+			Shutdown();
+		}
+		RaiseReaderError();
+		return true;
+	}
+
+	bool IsRunning() const { return !finished_.load(std::memory_order_acquire); }
+
+	dict Statistics() {
+		// the parser counters are written by the parser thread
+		unsigned long long processing_errors, parser_packets;
+		if (acquired_) {
+			processing_errors = parser_.ProcessingErrors();
+			parser_packets = parser_.PacketsProcessed();
+		}
+		else {
+			ScopedGILRelease nogil;
+			std::lock_guard<std::mutex> lock(parser_mutex_);
+			processing_errors = parser_.ProcessingErrors();
+			parser_packets = parser_.PacketsProcessed();
+		}
+
+		dict result;
+		result["packets_processed"] = packets_processed_.load(std::memory_order_relaxed);
+		result["bytes_read"] = bytes_read_.load(std::memory_order_relaxed);
+		result["overruns"] = overruns_.load(std::memory_order_relaxed);
+		result["ring_high_water"] = high_water_.load(std::memory_order_relaxed);
+		result["ring_fill"] = head_.load(std::memory_order_relaxed) - tail_.load(std::memory_order_relaxed);
+		result["ring_capacity"] = capacity_;
+		result["processing_errors"] = processing_errors;
+		result["parser_packets_processed"] = parser_packets;
+		return result;
+	}
+
+	// names of the tables updated since the last call, in arrival order
+	list Notifications() {
+		std::vector<const char*> events;
+		{
+			std::lock_guard<std::mutex> lock(events_mutex_);
+			events.swap(events_);
+		}
+		list result;
+		for (std::size_t i = 0; i < events.size(); ++i)
+			result.append(events[i]);
+		return result;
+	}
+
+	// holds the parser thread off the tables while Python reads them
+	void Acquire() {
+		if (acquired_) {
+			PyErr_SetString(PyExc_RuntimeError, "pipeline is already acquired");
+			throw_error_already_set();
+		}
+		{
+			ScopedGILRelease nogil;
+			parser_mutex_.lock();
+		}
+		acquired_ = true;
+	}
+
+	void Release() {
+		if (!acquired_) {
+			PyErr_SetString(PyExc_RuntimeError, "pipeline is not acquired");
+			throw_error_already_set();
+		}
+		acquired_ = false;
+		parser_mutex_.unlock();
+	}
+
+	static object Enter(object self) {
+		CapturePipeline& pipeline = extract<CapturePipeline&>(self);
+		pipeline.Acquire();
+		return self;
+	}
+
+	bool Exit(object, object, object) {
+		Release();
+		return false;
+	}
+
+private:
+	static TS_VOID TableObserver(TS_PVOID context, const ParserEvent& event) {
+		CapturePipeline* pipeline = reinterpret_cast<CapturePipeline*>(context);
+		std::lock_guard<std::mutex> lock(pipeline->events_mutex_);
+		pipeline->events_.push_back(EVENT_SOURCE_NAMES[event.source]);
+	}
+
+	void Launch(int fd, bool owns_fd) {
+		if (IsRunning()) {
+			if (owns_fd)
+				TSSIPY_CLOSE(fd);
+			PyErr_SetString(PyExc_RuntimeError, "pipeline is already running");
+			throw_error_already_set();
+		}
+		{
+			ScopedGILRelease nogil;
+			Shutdown();
+		}
+
+		fd_ = fd;
+		owns_fd_ = owns_fd;
+		error_ = 0;
+		pending_ = 0;
+		head_.store(0);
+		tail_.store(0);
+		stop_.store(false);
+		eof_.store(false);
+		finished_.store(false);
+		reader_ = std::thread(&CapturePipeline::ReaderLoop, this);
+		worker_ = std::thread(&CapturePipeline::ParserLoop, this);
+	}
+
+	// called without the GIL
+	void Shutdown() {
+		stop_.store(true, std::memory_order_release);
+		if (reader_.joinable())
+			reader_.join();
+		if (worker_.joinable())
+			worker_.join();
+		if (owns_fd_ && fd_ >= 0)
+			TSSIPY_CLOSE(fd_);
+		fd_ = -1;
+		owns_fd_ = false;
+		finished_.store(true, std::memory_order_release);
+	}
+
+	void RaiseReaderError() {
+		if (error_ != 0) {
+			errno = error_;
+			error_ = 0;
+			RaiseIOError("<pipeline>");
+		}
+	}
+
+	// waits for the descriptor to become readable so Stop is noticed on
+	// idle pipes and devices
+	bool Readable() {
+#ifndef _WIN32
+		pollfd request;
+		request.fd = fd_;
+		request.events = POLLIN;
+		request.revents = 0;
+		return poll(&request, 1, 100) != 0;
+#else
+		return true;
+#endif
+	}
+
+	Py_ssize_t ReadSome(unsigned char* target, std::size_t length) {
+		Py_ssize_t got;
+		do {
+			if (!Readable())
+				return -EAGAIN;
+			got = TSSIPY_READ(fd_, target, length);
+		} while (got < 0 && errno == EINTR && !stop_.load(std::memory_order_relaxed));
+		return got < 0 ? -errno : got;
+	}
+
+	void ReaderLoop() {
+		std::vector<unsigned char> scratch(188 * 256);
+		unsigned long long dropped = 0;
+
+		while (!stop_.load(std::memory_order_relaxed)) {
+			const std::size_t head = head_.load(std::memory_order_relaxed);
+			const std::size_t used = head - tail_.load(std::memory_order_acquire);
+			const std::size_t free_packets = capacity_ - used;
+
+			Py_ssize_t got;
+			if (free_packets == 0 || dropped % 188 != 0) {
+				if (block_ && dropped % 188 == 0) {
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+					continue;
+				}
+				// ring overrun: discard whole packets until the parser catches up
+				const std::size_t want = dropped % 188 != 0 ? 188 - dropped % 188 : scratch.size();
+				got = ReadSome(&scratch[0], want);
+				if (got > 0) {
+					const unsigned long long before = dropped / 188;
+					dropped += static_cast<unsigned long long>(got);
+					overruns_.fetch_add((dropped + 187) / 188 - before, std::memory_order_relaxed);
+				}
+			}
+			else {
+				const std::size_t slot = head % capacity_;
+				const std::size_t contiguous = std::min(free_packets, capacity_ - slot);
+				got = ReadSome(&ring_[slot * 188 + pending_], contiguous * 188 - pending_);
+				if (got > 0) {
+					const std::size_t total = pending_ + static_cast<std::size_t>(got);
+					pending_ = total % 188;
+					head_.store(head + total / 188, std::memory_order_release);
+					if (used + total / 188 > high_water_.load(std::memory_order_relaxed))
+						high_water_.store(used + total / 188, std::memory_order_relaxed);
+				}
+			}
+
+			if (got == -EAGAIN)
+				continue;
+			if (got < 0) {
+				if (!stop_.load(std::memory_order_relaxed))
+					error_ = static_cast<int>(-got);
+				break;
+			}
+			if (got == 0)
+				break;
+			bytes_read_.fetch_add(static_cast<unsigned long long>(got), std::memory_order_relaxed);
+		}
+		eof_.store(true, std::memory_order_release);
+	}
+
+	void ParserLoop() {
+		while (!stop_.load(std::memory_order_relaxed)) {
+			const std::size_t tail = tail_.load(std::memory_order_relaxed);
+			const bool eof = eof_.load(std::memory_order_acquire);
+			const std::size_t head = head_.load(std::memory_order_acquire);
+			if (head == tail) {
+				if (eof)
+					break;
+				std::this_thread::sleep_for(std::chrono::microseconds(500));
+				continue;
+			}
+
+			const std::size_t slot = tail % capacity_;
+			const std::size_t count = std::min(head - tail, capacity_ - slot);
+			{
+				std::lock_guard<std::mutex> lock(parser_mutex_);
+				parser_.ProcessData(&ring_[slot * 188], static_cast<unsigned>(count * 188));
+			}
+			tail_.store(tail + count, std::memory_order_release);
+			packets_processed_.fetch_add(count, std::memory_order_relaxed);
+		}
+		finished_.store(true, std::memory_order_release);
+	}
+
+	object parser_object_;
+	PythonParser& parser_;
+	const std::size_t capacity_;
+	std::vector<unsigned char> ring_;
+	const bool block_;
+	int fd_;
+	bool owns_fd_;
+	int error_;
+	std::size_t pending_;
+
+	std::thread reader_;
+	std::thread worker_;
+	std::mutex parser_mutex_;
+	bool acquired_;              // parser_mutex_ held by Python, guarded by the GIL
+	std::mutex events_mutex_;
+	std::vector<const char*> events_;
+
+	std::atomic<std::size_t> head_;
+	std::atomic<std::size_t> tail_;
+	std::atomic<bool> stop_;
+	std::atomic<bool> eof_;
+	std::atomic<bool> finished_;
+	std::atomic<unsigned long long> packets_processed_;
+	std::atomic<unsigned long long> bytes_read_;
+	std::atomic<unsigned long long> overruns_;
+	std::atomic<std::size_t> high_water_;
+};
+
+#endif // __TSSIPYTHON_PIPELINE_H_INCLUDED__
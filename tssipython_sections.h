@@ -0,0 +1,209 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_SECTIONS_H_INCLUDED__
+#define __TSSIPYTHON_SECTIONS_H_INCLUDED__
+
+#include "tssipython.h"
+
+// packet kinds by PID, as classified by the parser
+enum PacketKind {
+	KIND_NONE, KIND_PAT, KIND_PMT, KIND_NIT, KIND_SDT, KIND_EIT, KIND_TDT, KIND_AIT,
+	KIND_DSMCC, KIND_EBU, KIND_OTHER, KIND_COUNT
+};
+
+static const char* const PACKET_KIND_NAMES[KIND_COUNT] = {
+	"", "PAT", "PMT", "NIT", "SDT", "EIT", "TDT", "AIT", "DSMCC", "EBU", "other"
+};
+
+// kinds whose events are attributed to sections
+inline bool IsSectionKind(unsigned char kind) {
+	return kind >= KIND_PAT && kind <= KIND_AIT;
+}
+
+// section assembly
+//
+// The parser reassembles the sections on PIDs of section kinds next to
+// libtssi, so table events can be attributed to the section that completed
+// them and native observers see every section. Long sections are only
+// passed on with a valid CRC.
+
+// CRC-32/MPEG-2; 0 over a section including its CRC
+inline unsigned SectionCrc(const unsigned char* data, std::size_t length) {
+	static unsigned table[256];
+	static std::once_flag initialized;
+	std::call_once(initialized, []() {
+		for (unsigned i = 0; i < 256; ++i) {
+			unsigned crc = i << 24;
+			for (int bit = 0; bit < 8; ++bit)
+				crc = crc & 0x80000000 ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+			table[i] = crc;
+		}
+	});
+	unsigned crc = 0xFFFFFFFF;
+	for (std::size_t i = 0; i < length; ++i)
+		crc = (crc << 8) ^ table[((crc >> 24) ^ data[i]) & 0xFF];
+	return crc;
+}
+
+class SectionAssembler : boost::noncopyable {
+public:
+	SectionAssembler() : assemblies_(8192) {}
+
+	// calls complete(pid, section, length) for every section the packet
+	// completes, in stream order
+	template<class F> void Feed(const unsigned char* packet, unsigned pid, F complete) {
+		if (!(packet[3] & 0x10))
+			return;
+		Assembly& assembly = assemblies_[pid];
+		const unsigned char continuity = packet[3] & 0x0F;
+		if (assembly.active && continuity == assembly.continuity)
+			return;    // duplicate
+		if (assembly.active && continuity != ((assembly.continuity + 1) & 0x0F))
+			assembly.active = false;
+		assembly.continuity = continuity;
+
+		unsigned offset = 4;
+		if (packet[3] & 0x20)
+			offset += 1 + packet[4];
+		if (offset >= 188)
+			return;
+		const char* payload = reinterpret_cast<const char*>(packet) + offset;
+		unsigned available = 188 - offset;
+
+		if (packet[1] & 0x40) {
+			const unsigned pointer = static_cast<unsigned char>(payload[0]);
+			++payload;
+			--available;
+			if (pointer > available) {
+				assembly.active = false;
+				return;
+			}
+			if (assembly.active) {
+				assembly.data.append(payload, pointer);
+				Extract(assembly, pid, complete);
+			}
+			payload += pointer;
+			available -= pointer;
+			assembly.data.clear();
+			assembly.active = true;
+		}
+		else if (!assembly.active) {
+			return;
+		}
+		assembly.data.append(payload, available);
+		Extract(assembly, pid, complete);
+	}
+
+	TS_VOID Clear() {
+		for (std::size_t i = 0; i < assemblies_.size(); ++i) {
+			assemblies_[i].active = false;
+			assemblies_[i].data.clear();
+		}
+	}
+
+private:
+	struct Assembly {
+		Assembly() : active(false), continuity(0) {}
+		std::string data;
+		bool active;
+		unsigned char continuity;
+	};
+
+	// hands on the complete sections at the front, stops at stuffing
+	template<class F> void Extract(Assembly& assembly, unsigned pid, F& complete) {
+		std::size_t start = 0;
+		while (assembly.active && assembly.data.size() - start >= 3) {
+			const unsigned char* section = reinterpret_cast<const unsigned char*>(assembly.data.data()) + start;
+			if (section[0] == 0xFF) {
+				assembly.active = false;
+				break;
+			}
+			const std::size_t length = 3 + (((section[1] & 0x0F) << 8) | section[2]);
+			if (assembly.data.size() - start < length)
+				break;
+			if (!(section[1] & 0x80) || (length >= 12 && SectionCrc(section, length) == 0))
+				complete(pid, section, static_cast<unsigned>(length));
+			start += length;
+		}
+		if (!assembly.active)
+			assembly.data.clear();
+		else
+			assembly.data.erase(0, start);
+	}
+
+	std::vector<Assembly> assemblies_;
+};
+
+// section recorder for parser state snapshots
+//
+// libtssi has no way to set table contents, so a snapshot holds the raw
+// PSI/SI sections instead: the recorder keeps the current version of every
+// section the parser assembles. Loading a snapshot feeds the sections back
+// through the parser.
+class SectionRecorder : boost::noncopyable {
+public:
+	// (pid, section) in PID order, so the PAT comes first
+	template<class F> void ForEach(F visit) const {
+		for (std::map<std::string, std::string>::const_iterator it = sections_.begin(); it != sections_.end(); ++it)
+			visit((static_cast<unsigned char>(it->first[0]) << 8) | static_cast<unsigned char>(it->first[1]), it->second);
+	}
+
+	std::size_t Size() const { return sections_.size(); }
+
+	TS_VOID Clear() { sections_.clear(); }
+
+	// Key: PID, table id, then for long sections the table id extension,
+	// original network and transport stream of SDT and EIT, and the section
+	// number last. A new version of a table drops all sections of the old.
+	TS_VOID Store(unsigned pid, const unsigned char* section, std::size_t length) {
+		std::string key;
+		key += static_cast<char>(pid >> 8);
+		key += static_cast<char>(pid & 0xFF);
+		key += static_cast<char>(section[0]);
+
+		if (section[1] & 0x80) {
+			if (!(section[5] & 0x01))
+				return;
+			key.append(reinterpret_cast<const char*>(section) + 3, 2);
+			const unsigned char table_id = section[0];
+			if (table_id == 0x42 || table_id == 0x46 || (table_id >= 0x4E && table_id <= 0x6F))
+				key.append(reinterpret_cast<const char*>(section) + 8, table_id >= 0x4E ? 4 : 2);
+
+			const unsigned char version = section[5] & 0x3E;
+			std::map<std::string, std::string>::iterator it = sections_.lower_bound(key);
+			while (it != sections_.end() && it->first.size() == key.size() + 1 && it->first.compare(0, key.size(), key) == 0) {
+				if ((static_cast<unsigned char>(it->second[5]) & 0x3E) != version)
+					sections_.erase(it++);
+				else
+					++it;
+			}
+			key += static_cast<char>(section[6]);
+		}
+
+		sections_[key].assign(reinterpret_cast<const char*>(section), length);
+	}
+
+private:
+	std::map<std::string, std::string> sections_;
+};
+
+#endif // __TSSIPYTHON_SECTIONS_H_INCLUDED__
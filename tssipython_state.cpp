@@ -0,0 +1,184 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_state.h"
+#include "tssipython_ingest.h"
+
+// parser state snapshots
+//
+// File layout: "TSSISNAP", format version and section count as 32 bit
+// little endian words, then per section its PID and length as 16 bit little
+// endian words followed by the section.
+
+static const char SNAPSHOT_MAGIC[8] = { 'T', 'S', 'S', 'I', 'S', 'N', 'A', 'P' };
+static const unsigned SNAPSHOT_VERSION = 1;
+
+static void PutLittleEndian(std::string& target, unsigned value, int bytes) {
+	for (int i = 0; i < bytes; ++i, value >>= 8)
+		target += static_cast<char>(value & 0xFF);
+}
+
+static unsigned GetLittleEndian(const unsigned char* source, int bytes) {
+	unsigned value = 0;
+	for (int i = bytes - 1; i >= 0; --i)
+		value = value << 8 | source[i];
+	return value;
+}
+
+// one section per packet run, starting with pointer field 0
+static void PacketizeSection(unsigned pid, const unsigned char* section, std::size_t length, std::vector<unsigned char>& continuity, std::vector<unsigned char>& packets) {
+	std::size_t done = 0;
+	for (bool first = true; first || done < length; first = false) {
+		const std::size_t start = packets.size();
+		packets.resize(start + 188, 0xFF);
+		unsigned char* packet = &packets[start];
+		packet[0] = 0x47;
+		packet[1] = static_cast<unsigned char>((first ? 0x40 : 0x00) | pid >> 8);
+		packet[2] = static_cast<unsigned char>(pid & 0xFF);
+		packet[3] = static_cast<unsigned char>(0x10 | continuity[pid]);
+		continuity[pid] = (continuity[pid] + 1) & 0x0F;
+		unsigned offset = 4;
+		if (first)
+			packet[offset++] = 0x00;
+		const std::size_t chunk = std::min<std::size_t>(188 - offset, length - done);
+		std::memcpy(packet + offset, section + done, chunk);
+		done += chunk;
+	}
+}
+
+// writes the recorded sections to path, replacing it atomically; returns
+// the number of sections
+std::size_t ParserSaveState(PythonParser& self, std::string path) {
+	std::string snapshot(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	const std::string temporary = path + ".tmp";
+	std::size_t count = 0;
+	bool recorded = false;
+	bool written = false;
+	{
+		ScopedGILRelease nogil;
+		{
+			std::lock_guard<std::recursive_mutex> lock(self.ProcessingMutex());
+			const SectionRecorder* recorder = self.Sections();
+			recorded = recorder != 0;
+			if (recorded) {
+				count = recorder->Size();
+				PutLittleEndian(snapshot, SNAPSHOT_VERSION, 4);
+				PutLittleEndian(snapshot, static_cast<unsigned>(count), 4);
+				recorder->ForEach([&snapshot](unsigned pid, const std::string& section) {
+					PutLittleEndian(snapshot, pid, 2);
+					PutLittleEndian(snapshot, static_cast<unsigned>(section.size()), 2);
+					snapshot += section;
+				});
+			}
+		}
+
+		std::FILE* file = recorded ? std::fopen(temporary.c_str(), "wb") : 0;
+		if (file) {
+			written = std::fwrite(snapshot.data(), 1, snapshot.size(), file) == snapshot.size();
+			written = std::fclose(file) == 0 && written;
+#ifdef _WIN32
+			std::remove(path.c_str());
+#endif
+			written = written && std::rename(temporary.c_str(), path.c_str()) == 0;
+		}
+	}
+	if (!recorded) {
+		PyErr_SetString(PyExc_RuntimeError, "sections are not recorded, call RecordSections(True) first");
+		throw_error_already_set();
+	}
+	if (!written) {
+		const int error = errno;
+		std::remove(temporary.c_str());
+		errno = error;
+		RaiseIOError(path);
+	}
+	return count;
+}
+
+// Replays the sections of a snapshot through the parser, as if they had
+// just been received; later sections with the same version change nothing.
+// Returns the number of sections.
+std::size_t ParserLoadState(PythonParser& self, std::string path) {
+	FileDescriptor file(TSSIPY_OPEN(path.c_str(), TSSIPY_OPEN_FLAGS));
+	if (file.get() < 0)
+		RaiseIOError(path);
+	struct stat info;
+	if (fstat(file.get(), &info) != 0)
+		RaiseIOError(path);
+	const std::size_t size = static_cast<std::size_t>(info.st_size);
+
+	std::vector<unsigned char> packets;
+	std::size_t count = 0;
+	bool valid = size >= 16;
+	bool io_error = false;
+	{
+		ScopedGILRelease nogil;
+		const unsigned char* data = 0;
+#ifndef _WIN32
+		void* mapping = MAP_FAILED;
+		if (valid) {
+			mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, file.get(), 0);
+			io_error = mapping == MAP_FAILED;
+			data = static_cast<const unsigned char*>(mapping);
+		}
+#else
+		std::vector<unsigned char> contents(size);
+		for (std::size_t done = 0; valid && done < size && !io_error; ) {
+			const Py_ssize_t got = TSSIPY_READ(file.get(), &contents[done], size - done);
+			io_error = got <= 0;
+			done += got > 0 ? static_cast<std::size_t>(got) : 0;
+		}
+		data = size ? &contents[0] : 0;
+#endif
+		if (valid && !io_error) {
+			valid = std::memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 && GetLittleEndian(data + 8, 4) == SNAPSHOT_VERSION;
+			count = GetLittleEndian(data + 12, 4);
+			std::vector<unsigned char> continuity(8192, 0);
+			std::size_t position = 16;
+			for (std::size_t i = 0; valid && i < count; ++i) {
+				valid = position + 4 <= size;
+				if (!valid)
+					break;
+				const unsigned pid = GetLittleEndian(data + position, 2) & 0x1FFF;
+				const std::size_t length = GetLittleEndian(data + position + 2, 2);
+				position += 4;
+				valid = position + length <= size;
+				if (valid)
+					PacketizeSection(pid, data + position, length, continuity, packets);
+				position += length;
+			}
+		}
+#ifndef _WIN32
+		if (mapping != MAP_FAILED)
+			munmap(mapping, size);
+#endif
+		if (valid && !io_error && !packets.empty())
+			self.ProcessUnfiltered(&packets[0], static_cast<unsigned>(packets.size()));
+	}
+	if (io_error)
+		RaiseIOError(path);
+	if (!valid) {
+		PyErr_SetString(PyExc_ValueError, (path + " is not a parser state snapshot").c_str());
+		throw_error_already_set();
+	}
+	self.DeliverEvents();
+	return count;
+}
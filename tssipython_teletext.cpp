@@ -0,0 +1,121 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#include "tssipython_teletext.h"
+#include "tssipython_parser.h"
+
+static void AppendPageRecord(const tssi::EbuPage& page, std::string& records) {
+	const std::size_t start = records.size();
+	records.resize(start + TELETEXT_RECORD_SIZE, ' ');
+	char* record = &records[start];
+
+	record[0] = static_cast<char>(page.magazine);
+	record[1] = static_cast<char>(page.page_number);
+	record[2] = static_cast<char>(page.sub_page_number & 0xFF);
+	record[3] = static_cast<char>(page.sub_page_number >> 8);
+	record[4] = static_cast<char>((page.erase_page_flag ? 0x01 : 0) | (page.newsflash_flag ? 0x02 : 0) |
+		(page.subtitle_flag ? 0x04 : 0) | (page.suppress_header_flag ? 0x08 : 0) |
+		(page.update_indicator_flag ? 0x10 : 0) | (page.interrupted_sequence_flag ? 0x20 : 0) |
+		(page.inhibit_display_flag ? 0x40 : 0) | (page.magazine_serial_flag ? 0x80 : 0));
+	record[5] = static_cast<char>(page.language_code);
+	record[7] = 0;
+
+	char* cells = record + TELETEXT_HEADER_SIZE;
+	const std::string header = page.GetHeaderData();
+	const std::size_t header_length = std::min<std::size_t>(header.size(), 40);
+	std::memcpy(cells + 40 - header_length, header.data(), header_length);
+
+	unsigned rows = 0;
+	for (unsigned i = 0; i < page.GetPageLineListLength(); ++i) {
+		const tssi::EbuLine& line = page.GetPageLine(i);
+		if (line.packet < 1 || line.packet > 24)
+			continue;
+		const std::string data = line.GetLineData();
+		std::memcpy(cells + line.packet * 40, data.data(), std::min<std::size_t>(data.size(), 40));
+		++rows;
+	}
+	record[6] = static_cast<char>(rows);
+}
+
+std::string PythonParser::TeletextPage(unsigned magazine, unsigned page_number, unsigned sub_page_number) {
+	std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+	tssi::Packet_Ebu& ebu = PacketEbu();
+	std::string record;
+	for (unsigned i = 0; i < ebu.GetEbuPageListLength(); ++i) {
+		const tssi::EbuPage& page = ebu.GetEbuPage(i);
+		if (page.magazine == magazine && page.page_number == page_number && page.sub_page_number == sub_page_number) {
+			AppendPageRecord(page, record);
+			break;
+		}
+	}
+	return record;
+}
+
+// pages are only walked if libtssi has reported new pages in between
+std::string PythonParser::UpdatedTeletextPages() {
+	std::lock_guard<std::recursive_mutex> lock(processing_mutex_);
+	std::string records;
+	const unsigned long long updates = Updates(SOURCE_EBU);
+	if (updates == teletext_seen_)
+		return records;
+	teletext_seen_ = updates;
+
+	tssi::Packet_Ebu& ebu = PacketEbu();
+	std::string record;
+	for (unsigned i = 0; i < ebu.GetEbuPageListLength(); ++i) {
+		const tssi::EbuPage& page = ebu.GetEbuPage(i);
+		record.clear();
+		AppendPageRecord(page, record);
+		const unsigned long long fingerprint = Fingerprint().Add(record).Value();
+		unsigned long long& previous = teletext_fingerprints_[static_cast<unsigned>(page.magazine) << 24 | static_cast<unsigned>(page.page_number) << 16 | page.sub_page_number];
+		if (previous != fingerprint) {
+			previous = fingerprint;
+			records += record;
+		}
+	}
+	return records;
+}
+
+// one record, KeyError if the page has not been received
+object EbuPageSnapshot(tssi::Packet_Ebu& self, unsigned magazine, unsigned page_number, unsigned sub_page_number) {
+	PythonParser& parser = *FindCallbackSlot(&self).parser;
+	std::string record;
+	{
+		ScopedGILRelease nogil;
+		record = parser.TeletextPage(magazine, page_number, sub_page_number);
+	}
+	if (record.empty()) {
+		PyErr_SetString(PyExc_KeyError, "teletext page not received");
+		throw_error_already_set();
+	}
+	return BytesObject(record);
+}
+
+// records of the pages new or changed since the last call
+object EbuUpdatedPages(tssi::Packet_Ebu& self) {
+	PythonParser& parser = *FindCallbackSlot(&self).parser;
+	std::string records;
+	{
+		ScopedGILRelease nogil;
+		records = parser.UpdatedTeletextPages();
+	}
+	return BytesObject(records);
+}
@@ -0,0 +1,43 @@
+/*++
+*    libtssipython - Python wrapper for libtssi
+           parse MPEG-2 TS and DVB Service Information in Python
+*
+*    Copyright (C) 2009, 2016 Martin Hoernig (goforcode.com)
+*
+*    This program is free software: you can redistribute it and/or modify
+*    it under the terms of the GNU General Public License as published by
+*    the Free Software Foundation, either version 3 of the License, or
+*    (at your option) any later version.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU General Public License for more details.
+*
+*    You should have received a copy of the GNU General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+--*/
+
+#ifndef __TSSIPYTHON_TELETEXT_H_INCLUDED__
+#define __TSSIPYTHON_TELETEXT_H_INCLUDED__
+
+#include "tssipython.h"
+
+// teletext page snapshots
+//
+// A record is an 8 byte header (magazine, page_number, sub_page_number
+// little endian, flags, language_code, rows received, 0) followed by 25
+// rows of 40 cells. Row 0 holds the header text right-aligned, rows not
+// received are spaces. Flags from bit 0: erase_page, newsflash, subtitle,
+// suppress_header, update_indicator, interrupted_sequence, inhibit_display,
+// magazine_serial.
+
+static const std::size_t TELETEXT_HEADER_SIZE = 8;
+static const std::size_t TELETEXT_RECORD_SIZE = TELETEXT_HEADER_SIZE + 25 * 40;
+
+// Packet_Ebu.GetPageSnapshot and Packet_Ebu.GetUpdatedPages
+object EbuPageSnapshot(tssi::Packet_Ebu& self, unsigned magazine, unsigned page_number, unsigned sub_page_number);
+object EbuUpdatedPages(tssi::Packet_Ebu& self);
+
+#endif // __TSSIPYTHON_TELETEXT_H_INCLUDED__